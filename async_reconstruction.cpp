@@ -0,0 +1,201 @@
+#include "async_reconstruction.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+namespace AsyncReconstruction {
+
+static size_t resolveWorkerCount(int workerCount) {
+    int jobThreads = Threading::currentConfig().jobThreads;
+    if (workerCount <= 0) {
+        return static_cast<size_t>(jobThreads);
+    }
+    if (workerCount > jobThreads) {
+        std::cerr << "Scheduler runs " << workerCount << " workers but the threading configuration "
+                  << "reserves " << jobThreads << " job threads; cores will be oversubscribed" << std::endl;
+    }
+    return static_cast<size_t>(workerCount);
+}
+
+Scheduler::Scheduler(int workerCount, int maxQueued, OverflowPolicy policy)
+    : workerCount(resolveWorkerCount(workerCount)),
+      maxQueued(static_cast<size_t>(std::max(0, maxQueued))), policy(policy),
+      running(0), nextId(1), stopping(false) {
+    for (size_t i = 0; i < this->workerCount; i++) {
+        workers.emplace_back(&Scheduler::workerLoop, this);
+    }
+}
+
+Scheduler::~Scheduler() {
+    shutdown();
+}
+
+// Queued jobs up to the number of idle workers are handed off right away; only the rest wait
+bool Scheduler::hasSlot() const {
+    size_t idle = workerCount - std::min(running, workerCount);
+    return queue.size() < maxQueued + idle;
+}
+
+uint64_t Scheduler::enqueue(std::function<void(uint64_t)> run, std::function<void(uint64_t)> cancel) {
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    if (policy == BLOCK_WHEN_FULL) {
+        slotAvailable.wait(lock, [this] { return stopping || hasSlot(); });
+    }
+    
+    if (stopping || !hasSlot()) {
+        return 0;
+    }
+    
+    uint64_t id = nextId++;
+    queue.push_back(Job{id, std::move(run), std::move(cancel)});
+    jobAvailable.notify_one();
+    return id;
+}
+
+Ticket<StereoReconstruction::ReconstructionOutput> Scheduler::submit(
+    const StereoReconstruction::ReconstructionParams& params) {
+    auto promise = std::make_shared<std::promise<StereoReconstruction::ReconstructionOutput>>();
+    
+    Ticket<StereoReconstruction::ReconstructionOutput> ticket;
+    ticket.result = promise->get_future();
+    ticket.jobId = enqueue(
+        [promise, params](uint64_t) {
+            try {
+                promise->set_value(StereoReconstruction::performStereoReconstruction(params));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        },
+        [promise](uint64_t) { promise->set_exception(std::make_exception_ptr(JobCancelled())); });
+    ticket.accepted = ticket.jobId != 0;
+    if (!ticket.accepted) {
+        promise->set_exception(std::make_exception_ptr(JobRejected()));
+    }
+    return ticket;
+}
+
+uint64_t Scheduler::submit(const StereoReconstruction::ReconstructionParams& params,
+                           ReconstructionCallback callback) {
+    return enqueue(
+        [params, callback](uint64_t jobId) {
+            StereoReconstruction::ReconstructionOutput output =
+                StereoReconstruction::performStereoReconstruction(params);
+            callback(jobId, output);
+        },
+        [callback](uint64_t jobId) {
+            StereoReconstruction::ReconstructionOutput cancelled;
+            cancelled.success = false;
+            callback(jobId, cancelled);
+        });
+}
+
+Ticket<Modeling3D::ModelingResult> Scheduler::submitModeling(const Modeling3D::ModelingParams& params) {
+    auto promise = std::make_shared<std::promise<Modeling3D::ModelingResult>>();
+    
+    Ticket<Modeling3D::ModelingResult> ticket;
+    ticket.result = promise->get_future();
+    ticket.jobId = enqueue(
+        [promise, params](uint64_t) {
+            try {
+                promise->set_value(Modeling3D::performModeling(params));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        },
+        [promise](uint64_t) { promise->set_exception(std::make_exception_ptr(JobCancelled())); });
+    ticket.accepted = ticket.jobId != 0;
+    if (!ticket.accepted) {
+        promise->set_exception(std::make_exception_ptr(JobRejected()));
+    }
+    return ticket;
+}
+
+bool Scheduler::cancel(uint64_t jobId) {
+    std::function<void(uint64_t)> onCancel;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->id == jobId) {
+                onCancel = std::move(it->cancel);
+                queue.erase(it);
+                break;
+            }
+        }
+    }
+    
+    if (!onCancel) {
+        return false;
+    }
+    slotAvailable.notify_one();
+    onCancel(jobId);
+    return true;
+}
+
+size_t Scheduler::queuedCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+size_t Scheduler::inFlightCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+void Scheduler::shutdown() {
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping && workers.empty()) {
+            return;
+        }
+        stopping = true;
+        dropped.swap(queue);
+    }
+    jobAvailable.notify_all();
+    slotAvailable.notify_all();
+    
+    for (auto& job : dropped) {
+        job.cancel(job.id);
+    }
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+}
+
+void Scheduler::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            running++;
+        }
+        
+        try {
+            job.run(job.id);
+        } catch (const std::exception& e) {
+            std::cerr << "Error in asynchronous job " << job.id << ": " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Unknown error in asynchronous job " << job.id << std::endl;
+        }
+        
+        // An idle worker frees a slot (taking a job off the queue does not)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        slotAvailable.notify_one();
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include "modeling_3d.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace AsyncReconstruction {
+    enum OverflowPolicy {
+        REJECT_WHEN_FULL = 0, // submit returns a ticket with accepted == false
+        BLOCK_WHEN_FULL = 1   // submit waits until a queue slot frees up
+    };
+    
+    template <typename Result>
+    struct Ticket {
+        uint64_t jobId;  // 0 when rejected
+        bool accepted;
+        std::future<Result> result; // throws JobCancelled when cancelled while queued, JobRejected when rejected
+    };
+    
+    struct JobCancelled : std::runtime_error {
+        JobCancelled() : std::runtime_error("Job cancelled before it started") {}
+    };
+    
+    struct JobRejected : std::runtime_error {
+        JobRejected() : std::runtime_error("Job rejected: scheduler full or shutting down") {}
+    };
+    
+    using ReconstructionCallback =
+        std::function<void(uint64_t jobId, const StereoReconstruction::ReconstructionOutput& output)>;
+    
+    // Front end for the blocking reconstruction calls. At most workerCount pairs are in
+    // flight (bounding memory), at most maxQueued wait behind them. With maxQueued = 0 a job
+    // is only accepted when a worker is idle to take it.
+    class Scheduler {
+    public:
+        // workerCount <= 0 uses Threading's jobThreads, which the OpenCV thread count already
+        // accounts for; more workers than that oversubscribe the cores
+        Scheduler(int workerCount, int maxQueued, OverflowPolicy policy = REJECT_WHEN_FULL);
+        ~Scheduler();
+        
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        
+        Ticket<StereoReconstruction::ReconstructionOutput> submit(
+            const StereoReconstruction::ReconstructionParams& params);
+        
+        // Completion callback variant; runs on the worker thread, returns 0 when rejected
+        uint64_t submit(const StereoReconstruction::ReconstructionParams& params,
+                        ReconstructionCallback callback);
+        
+        Ticket<Modeling3D::ModelingResult> submitModeling(const Modeling3D::ModelingParams& params);
+        
+        // Removes a job that has not started yet; running jobs are not interrupted
+        bool cancel(uint64_t jobId);
+        
+        size_t queuedCount() const;
+        size_t inFlightCount() const;
+        
+        // Cancels everything still queued and joins the workers after running jobs finish
+        void shutdown();
+        
+    private:
+        struct Job {
+            uint64_t id;
+            std::function<void(uint64_t)> run;
+            std::function<void(uint64_t)> cancel;
+        };
+        
+        uint64_t enqueue(std::function<void(uint64_t)> run, std::function<void(uint64_t)> cancel);
+        bool hasSlot() const; // caller holds mutex
+        void workerLoop();
+        
+        mutable std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable slotAvailable;
+        std::deque<Job> queue;
+        std::vector<std::thread> workers;
+        size_t workerCount;
+        size_t maxQueued;
+        OverflowPolicy policy;
+        size_t running;
+        uint64_t nextId;
+        bool stopping;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,432 @@
+#include "batch_runner.h"
+#include "stereo_reconstruction.h"
+#include "output_writer.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace BatchRunner {
+
+// Exclusive advisory lock on a file, released when the object goes out of scope
+class ManifestLock {
+public:
+    explicit ManifestLock(const std::string& lockFile) : locked(false) {
+#ifdef _WIN32
+        handle = CreateFileA(lockFile.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle != INVALID_HANDLE_VALUE) {
+            OVERLAPPED overlapped = {};
+            locked = LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped) != 0;
+        }
+#else
+        fd = open(lockFile.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd >= 0) {
+            locked = flock(fd, LOCK_EX) == 0;
+        }
+#endif
+    }
+    
+    ~ManifestLock() {
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE) {
+            if (locked) {
+                OVERLAPPED overlapped = {};
+                UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+            }
+            CloseHandle(handle);
+        }
+#else
+        if (fd >= 0) {
+            if (locked) {
+                flock(fd, LOCK_UN);
+            }
+            close(fd);
+        }
+#endif
+    }
+    
+    bool isLocked() const { return locked; }
+    
+private:
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    int fd;
+#endif
+    bool locked;
+};
+
+static long currentProcessId() {
+#ifdef _WIN32
+    return static_cast<long>(GetCurrentProcessId());
+#else
+    return static_cast<long>(getpid());
+#endif
+}
+
+static bool isProcessAlive(long pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return false;
+    }
+    DWORD exitCode = 0;
+    bool alive = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// Start time of a process in platform ticks, 0 when unknown; with the PID it identifies
+// the process even after the PID has been reused
+static unsigned long long processStartTime(long pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return 0;
+    }
+    FILETIME creation, exitTime, kernel, user;
+    unsigned long long start = 0;
+    if (GetProcessTimes(process, &creation, &exitTime, &kernel, &user)) {
+        start = (static_cast<unsigned long long>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+    }
+    CloseHandle(process);
+    return start;
+#else
+    // Field 22 of /proc/<pid>/stat; the command name in field 2 may contain spaces
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string content;
+    if (!stat.is_open() || !std::getline(stat, content)) {
+        return 0;
+    }
+    size_t commandEnd = content.rfind(')');
+    if (commandEnd == std::string::npos) {
+        return 0;
+    }
+    std::istringstream fields(content.substr(commandEnd + 1));
+    std::string field;
+    int index = 3;
+    while (index < 22 && (fields >> field)) {
+        index++;
+    }
+    unsigned long long start = 0;
+    fields >> start;
+    return start;
+#endif
+}
+
+static std::string hostName() {
+#ifdef _WIN32
+    char name[MAX_COMPUTERNAME_LENGTH + 1] = {};
+    DWORD length = sizeof(name);
+    return GetComputerNameA(name, &length) && length > 0 ? std::string(name, length) : std::string("localhost");
+#else
+    char name[256] = {};
+    return gethostname(name, sizeof(name) - 1) == 0 && name[0] ? std::string(name) : std::string("localhost");
+#endif
+}
+
+// Claim file content: <pid> <host> <start time>
+struct ClaimOwner {
+    long pid;
+    std::string host;
+    unsigned long long startTime;
+};
+
+static ClaimOwner currentOwner() {
+    static const ClaimOwner owner = {currentProcessId(), hostName(), processStartTime(currentProcessId())};
+    return owner;
+}
+
+// Only claims made on this host can be checked; a dead PID, or a live PID whose start time
+// differs from the recorded one (PID reuse), marks the claim as left over from a crash
+static bool isClaimStale(const ClaimOwner& owner) {
+    ClaimOwner self = currentOwner();
+    if (owner.host != self.host) {
+        return false;
+    }
+    // Our own claim, or one from an earlier process whose PID this process now has
+    if (owner.pid == self.pid) {
+        return true;
+    }
+    if (!isProcessAlive(owner.pid)) {
+        return true;
+    }
+    unsigned long long startTime = processStartTime(owner.pid);
+    return owner.startTime != 0 && startTime != 0 && startTime != owner.startTime;
+}
+
+static bool writeFileAtomically(const std::string& path, const std::string& content) {
+    std::string tempPath = path + ".tmp" + std::to_string(currentProcessId());
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open file for writing: " << tempPath << std::endl;
+            return false;
+        }
+        file << content;
+        file.flush();
+        if (!file) {
+            return false;
+        }
+    }
+    
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        std::cerr << "Cannot commit " << path << ": " << ec.message() << std::endl;
+        fs::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// A job ID names files in the state folder, so it must stay a plain file name
+static bool isValidJobId(const std::string& jobId) {
+    return !jobId.empty() && jobId.find('/') == std::string::npos &&
+           jobId.find('\\') == std::string::npos && jobId.find("..") == std::string::npos;
+}
+
+// Reads a whitespace separated field, or a double quoted one that may contain spaces
+static bool readField(std::istream& in, std::string& value) {
+    in >> std::ws;
+    if (in.peek() != '"') {
+        return static_cast<bool>(in >> value);
+    }
+    in.get();
+    if (!std::getline(in, value, '"') || in.eof()) {
+        return false;
+    }
+    return true;
+}
+
+bool loadManifest(const std::string& manifestFile, std::vector<BatchJob>& jobs) {
+    std::ifstream file(manifestFile);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open manifest: " << manifestFile << std::endl;
+        return false;
+    }
+    
+    jobs.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        
+        std::istringstream fields(line);
+        BatchJob job;
+        job.quality = 3;
+        if (!readField(fields, job.jobId) || !readField(fields, job.leftImagePath) ||
+            !readField(fields, job.rightImagePath) || !readField(fields, job.calibrationFile) ||
+            !readField(fields, job.outputFolder)) {
+            std::cerr << "Malformed manifest line " << lineNumber << ": " << line << std::endl;
+            return false;
+        }
+        if (!isValidJobId(job.jobId)) {
+            std::cerr << "Invalid job ID on manifest line " << lineNumber << ": " << job.jobId << std::endl;
+            return false;
+        }
+        fields >> job.quality;
+        jobs.push_back(job);
+    }
+    
+    return true;
+}
+
+std::string stateFolder(const std::string& manifestFile) {
+    return manifestFile + ".state";
+}
+
+bool isJobDone(const std::string& manifestFile, const std::string& jobId) {
+    return fs::exists(stateFolder(manifestFile) + "/" + jobId + ".done");
+}
+
+bool claimNextJob(const std::string& manifestFile, const std::vector<BatchJob>& jobs,
+                  const std::vector<std::string>& excluded, BatchJob& job) {
+    std::string state = stateFolder(manifestFile);
+    fs::create_directories(state);
+    
+    ManifestLock lock(manifestFile + ".lock");
+    if (!lock.isLocked()) {
+        std::cerr << "Cannot lock manifest: " << manifestFile << std::endl;
+        return false;
+    }
+    
+    for (const auto& candidate : jobs) {
+        if (std::find(excluded.begin(), excluded.end(), candidate.jobId) != excluded.end() ||
+            isJobDone(manifestFile, candidate.jobId)) {
+            continue;
+        }
+        
+        std::string claimPath = state + "/" + candidate.jobId + ".claim";
+        std::ifstream claim(claimPath);
+        ClaimOwner owner = {0, currentOwner().host, 0};
+        if (claim.is_open() && (claim >> owner.pid)) {
+            // Claims written before host and start time were recorded hold only the PID
+            claim >> owner.host >> owner.startTime;
+            if (!isClaimStale(owner)) {
+                continue;
+            }
+        }
+        claim.close();
+        
+        ClaimOwner self = currentOwner();
+        if (!writeFileAtomically(claimPath, std::to_string(self.pid) + " " + self.host + " " +
+                                            std::to_string(self.startTime) + "\n")) {
+            return false;
+        }
+        job = candidate;
+        return true;
+    }
+    
+    return false;
+}
+
+bool finishJob(const std::string& manifestFile, const BatchJob& job, bool success,
+               const std::string& message) {
+    std::string state = stateFolder(manifestFile);
+    bool committed = true;
+    
+    // Failed jobs keep no marker and are retried by the next run
+    if (success) {
+        committed = writeFileAtomically(state + "/" + job.jobId + ".done", message + "\n");
+    }
+    
+    std::error_code ec;
+    fs::remove(state + "/" + job.jobId + ".claim", ec);
+    return committed;
+}
+
+BatchSummary runBatch(const std::string& manifestFile, bool useResultCache) {
+    BatchSummary summary = {0, 0, 0, 0};
+    
+    std::vector<BatchJob> jobs;
+    if (!loadManifest(manifestFile, jobs)) {
+        return summary;
+    }
+    summary.total = static_cast<int>(jobs.size());
+    for (const auto& job : jobs) {
+        if (isJobDone(manifestFile, job.jobId)) {
+            summary.skipped++;
+        }
+    }
+    std::cout << "Batch manifest: " << summary.total << " jobs, " << summary.skipped
+              << " already done" << std::endl;
+    
+    // Jobs this process already attempted are not claimed again in the same run
+    std::vector<std::string> attempted;
+    
+    // The previous job's outputs are flushed while the next pair is matched; a job is only
+    // marked done once all of its artifacts are on disk
+    struct PendingJob {
+        BatchJob job;
+        OutputWriter::ArtifactFutures artifacts;
+        double seconds;
+    };
+    std::vector<PendingJob> pending;
+    
+    auto settle = [&](PendingJob& done) {
+        bool success = true;
+        for (const auto& status : OutputWriter::collect(done.artifacts)) {
+            success = success && status.success;
+        }
+        finishJob(manifestFile, done.job, success, "seconds " + std::to_string(done.seconds));
+        if (success) {
+            summary.completed++;
+        } else {
+            summary.failed++;
+            std::cerr << "Job " << done.job.jobId << " failed" << std::endl;
+        }
+    };
+    
+    BatchJob job;
+    while (claimNextJob(manifestFile, jobs, attempted, job)) {
+        attempted.push_back(job.jobId);
+        std::cout << "\n--- Job " << job.jobId << " ---" << std::endl;
+        
+        StereoReconstruction::ReconstructionParams params;
+        params.leftImagePath = job.leftImagePath;
+        params.rightImagePath = job.rightImagePath;
+        params.outputFolder = job.outputFolder;
+        params.calibrationFile = job.calibrationFile;
+        params.outputFormat = 0;
+        params.meshGeneration = 0;
+        params.quality = job.quality;
+        params.useColorTexture = true;
+        params.maxDepth = 10.0f;
+        params.minDepth = 0.1f;
+        params.algorithm = 1;
+        params.postProcessing = 2;
+        // Pairs repeated across jobs or reruns are restored instead of matched again
+        if (useResultCache) {
+            params.resultCacheFolder = manifestFile + ".cache";
+        }
+        
+        auto startTime = std::chrono::high_resolution_clock::now();
+        StereoReconstruction::ReconstructionOutput output;
+        output.success = false;
+        try {
+            output = StereoReconstruction::performStereoReconstruction(params);
+        } catch (const std::exception& e) {
+            std::cerr << "Error in job " << job.jobId << ": " << e.what() << std::endl;
+        }
+        auto endTime = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        
+        for (auto& previous : pending) {
+            settle(previous);
+        }
+        pending.clear();
+        
+        if (!output.success) {
+            finishJob(manifestFile, job, false, "");
+            summary.failed++;
+            std::cerr << "Job " << job.jobId << " failed" << std::endl;
+            continue;
+        }
+        
+        if (output.fromCache) {
+            std::cout << "Job " << job.jobId << " restored from " << params.resultCacheFolder
+                      << ": rectified images and residual map are not written" << std::endl;
+        }
+        
+        PendingJob current;
+        current.job = job;
+        current.seconds = seconds;
+        current.artifacts = OutputWriter::writeReconstructionOutputs(
+            OutputWriter::sharedWriter(), output, job.outputFolder, params.outputFormat,
+            params.useColorTexture, params.minConfidence);
+        pending.push_back(std::move(current));
+    }
+    
+    for (auto& previous : pending) {
+        settle(previous);
+    }
+    
+    std::cout << "Batch finished: " << summary.completed << " completed, " << summary.failed
+              << " failed, " << summary.skipped << " skipped" << std::endl;
+    return summary;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace BatchRunner {
+    // One manifest line: <jobId> <leftImage> <rightImage> <calibrationFile> <outputFolder> [quality]
+    // Fields are separated by whitespace; paths containing spaces are written in double quotes.
+    // The job ID names the state files, so it may not contain '/', '\\' or "..".
+    struct BatchJob {
+        std::string jobId;
+        std::string leftImagePath;
+        std::string rightImagePath;
+        std::string calibrationFile;
+        std::string outputFolder;
+        int quality;
+    };
+    
+    struct BatchSummary {
+        int completed;      // finished by this process
+        int failed;
+        int skipped;        // already done before this process started
+        int total;
+    };
+    
+    bool loadManifest(const std::string& manifestFile, std::vector<BatchJob>& jobs);
+    
+    // Completion markers and claims live next to the manifest in <manifest>.state/
+    std::string stateFolder(const std::string& manifestFile);
+    
+    bool isJobDone(const std::string& manifestFile, const std::string& jobId);
+    
+    // Claims the next job that is neither done nor held by a live worker. The scan runs
+    // under an exclusive lock on <manifest>.lock so concurrent processes never share a job.
+    // A claim records PID, host and process start time; claims from other hosts are never
+    // taken over, local ones only when the process is gone or its PID was reused.
+    bool claimNextJob(const std::string& manifestFile, const std::vector<BatchJob>& jobs,
+                      const std::vector<std::string>& excluded, BatchJob& job);
+    
+    // Writes the completion marker atomically (temp file + rename) and drops the claim
+    bool finishJob(const std::string& manifestFile, const BatchJob& job, bool success,
+                   const std::string& message);
+    
+    // Processes jobs until none are claimable; safe to restart after a crash. With
+    // useResultCache, results are cached in <manifest>.cache; jobs answered from it write the
+    // depth map and point cloud but no rectified images or residual map.
+    BatchSummary runBatch(const std::string& manifestFile, bool useResultCache = false);
+}
\ No newline at end of file
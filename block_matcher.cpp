@@ -0,0 +1,94 @@
+#include "block_matcher.h"
+#include <opencv2/opencv.hpp>
+#include <opencv2/calib3d.hpp>
+
+namespace BlockMatcher {
+
+void prefilterXSobel(const cv::Mat& gray, cv::Mat& filtered) {
+    cv::Mat sobel;
+    cv::Sobel(gray, sobel, CV_16S, 1, 0, 3);
+    
+    filtered.create(gray.size(), CV_8UC1);
+    for (int y = 0; y < gray.rows; y++) {
+        const short* s = sobel.ptr<short>(y);
+        uchar* f = filtered.ptr<uchar>(y);
+        for (int x = 0; x < gray.cols; x++) {
+            f[x] = static_cast<uchar>(std::min(std::max(static_cast<int>(s[x]), -PREFILTER_CAP), PREFILTER_CAP)
+                                      + PREFILTER_CAP);
+        }
+    }
+}
+
+template <int BLOCK>
+static RowKernel kernelForDisparities(int numDisparities) {
+    switch (numDisparities) {
+        case 32: return &matchRows<BLOCK, 32>;
+        case 48: return &matchRows<BLOCK, 48>;
+        case 64: return &matchRows<BLOCK, 64>;
+        case 96: return &matchRows<BLOCK, 96>;
+        case 128: return &matchRows<BLOCK, 128>;
+        default: return nullptr;
+    }
+}
+
+RowKernel specializedKernel(int blockSize, int numDisparities) {
+    switch (blockSize) {
+        // SGBM block sizes of matcherConfigForQuality
+        case 3: return kernelForDisparities<3>(numDisparities);
+        case 5: return kernelForDisparities<5>(numDisparities);
+        case 7: return kernelForDisparities<7>(numDisparities);
+        // StereoBM / SAD block sizes
+        case 15: return kernelForDisparities<15>(numDisparities);
+        case 21: return kernelForDisparities<21>(numDisparities);
+        case 25: return kernelForDisparities<25>(numDisparities);
+        default: return nullptr;
+    }
+}
+
+void computeDisparity(const cv::Mat& leftGray, const cv::Mat& rightGray, cv::Mat& disparity,
+                      int blockSize, int numDisparities, bool useSpecialized) {
+    CV_Assert(leftGray.type() == CV_8UC1 && rightGray.type() == CV_8UC1 &&
+              leftGray.size() == rightGray.size() &&
+              blockSize % 2 == 1 && blockSize >= 1 && numDisparities > 0);
+    
+    cv::Mat left, right;
+    prefilterXSobel(leftGray, left);
+    prefilterXSobel(rightGray, right);
+    
+    disparity.create(leftGray.size(), CV_16SC1);
+    
+    RowKernel kernel = useSpecialized ? specializedKernel(blockSize, numDisparities) : nullptr;
+    if (!kernel) {
+        kernel = &matchRows<0, 0>;
+    }
+    
+    // Each band re-primes blockSize rows of column sums, so keep bands well above that
+    int bandRows = std::max(4 * blockSize, 32);
+    int bandCount = (leftGray.rows + bandRows - 1) / bandRows;
+    
+    cv::parallel_for_(cv::Range(0, bandCount), [&](const cv::Range& range) {
+        for (int band = range.start; band < range.end; band++) {
+            cv::Range rows(band * bandRows, std::min((band + 1) * bandRows, leftGray.rows));
+            kernel(left, right, disparity, blockSize, numDisparities, rows);
+        }
+    });
+}
+
+SadBlockMatcher::SadBlockMatcher(int numDisparities, int blockSize)
+    : numDisparities(numDisparities), blockSize(blockSize),
+      speckleWindowSize(0), speckleRange(0), disp12MaxDiff(-1) {}
+
+void SadBlockMatcher::compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) {
+    cv::Mat leftGray = left.getMat();
+    cv::Mat rightGray = right.getMat();
+    
+    disparity.create(leftGray.size(), CV_16SC1);
+    cv::Mat result = disparity.getMat();
+    computeDisparity(leftGray, rightGray, result, blockSize, numDisparities);
+    
+    if (speckleWindowSize > 0) {
+        cv::filterSpeckles(result, INVALID_DISPARITY, speckleWindowSize, speckleRange);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace BlockMatcher {
+    const int DISP_SCALE = 16;          // fixed-point disparity, as StereoBM/StereoSGBM
+    const int INVALID_DISPARITY = -DISP_SCALE;
+    const int PREFILTER_CAP = 31;
+    const int UNIQUENESS_RATIO = 10;    // percent margin over the runner-up
+    const int OUT_OF_RANGE_COST = 255;  // columns with no right-image partner
+    
+    // x-Sobel response clipped to [-cap, cap] and shifted to [0, 2 * cap], as StereoBM's prefilter
+    void prefilterXSobel(const cv::Mat& gray, cv::Mat& filtered);
+    
+    namespace detail {
+        // colSum[x * D + d] += |L(y, x) - R(y, x - d)| (or -=); D is a compile-time
+        // constant for the specialized kernels so the d loop unrolls and vectorizes
+        template <int NDISP, bool ADD>
+        inline void accumulateRow(const uchar* left, const uchar* right, int width, int numDisparities,
+                                  unsigned short* colSum) {
+            const int D = NDISP > 0 ? NDISP : numDisparities;
+            const int fullStart = std::min(width, D - 1);
+            
+            for (int x = 0; x < fullStart; x++) {
+                unsigned short* c = colSum + static_cast<size_t>(x) * D;
+                const int lv = left[x];
+                for (int d = 0; d < D; d++) {
+                    int cost = d <= x ? std::abs(lv - right[x - d]) : OUT_OF_RANGE_COST;
+                    c[d] = static_cast<unsigned short>(ADD ? c[d] + cost : c[d] - cost);
+                }
+            }
+            
+            for (int x = fullStart; x < width; x++) {
+                unsigned short* c = colSum + static_cast<size_t>(x) * D;
+                const int lv = left[x];
+                const uchar* r = right + x;
+                for (int d = 0; d < D; d++) {
+                    int cost = std::abs(lv - r[-d]);
+                    c[d] = static_cast<unsigned short>(ADD ? c[d] + cost : c[d] - cost);
+                }
+            }
+        }
+    }
+    
+    // SAD winner-take-all with uniqueness check and parabolic sub-pixel refinement over
+    // rows [rows.start, rows.end) of a prefiltered pair. disparity is CV_16S scaled by
+    // DISP_SCALE with INVALID_DISPARITY where no unique match exists. BLOCK / NDISP of 0
+    // select the generic path driven by blockSize / numDisparities.
+    template <int BLOCK, int NDISP>
+    void matchRows(const cv::Mat& left, const cv::Mat& right, cv::Mat& disparity,
+                   int blockSize, int numDisparities, const cv::Range& rows) {
+        const int B = BLOCK > 0 ? BLOCK : blockSize;
+        const int D = NDISP > 0 ? NDISP : numDisparities;
+        const int h = B / 2;
+        const int width = left.cols;
+        const int height = left.rows;
+        
+        std::vector<unsigned short> colSum(static_cast<size_t>(width) * D, 0);
+        std::vector<int> winSum(D);
+        
+        auto clampRow = [height](int y) { return std::min(std::max(y, 0), height - 1); };
+        
+        // Column sums over the block rows around the first output row (replicated border)
+        for (int dy = -h; dy <= h; dy++) {
+            int y = clampRow(rows.start + dy);
+            detail::accumulateRow<NDISP, true>(left.ptr<uchar>(y), right.ptr<uchar>(y), width, D, colSum.data());
+        }
+        
+        for (int y = rows.start; y < rows.end; y++) {
+            short* out = disparity.ptr<short>(y);
+            std::fill(out, out + std::min(h, width), static_cast<short>(INVALID_DISPARITY));
+            std::fill(out + std::max(width - h, 0), out + width, static_cast<short>(INVALID_DISPARITY));
+            
+            if (width > 2 * h) {
+                std::fill(winSum.begin(), winSum.end(), 0);
+                for (int x = 0; x < B; x++) {
+                    const unsigned short* c = &colSum[static_cast<size_t>(x) * D];
+                    for (int d = 0; d < D; d++) {
+                        winSum[d] += c[d];
+                    }
+                }
+                
+                for (int x = h; x < width - h; x++) {
+                    if (x > h) {
+                        const unsigned short* add = &colSum[static_cast<size_t>(x + h) * D];
+                        const unsigned short* sub = &colSum[static_cast<size_t>(x - h - 1) * D];
+                        for (int d = 0; d < D; d++) {
+                            winSum[d] += add[d] - sub[d];
+                        }
+                    }
+                    
+                    // Branch-free reductions over d so fixed-D loops vectorize
+                    const int* w = winSum.data();
+                    int bestCost = w[0];
+                    for (int d = 1; d < D; d++) {
+                        bestCost = std::min(bestCost, w[d]);
+                    }
+                    int best = 0;
+                    while (w[best] != bestCost) {
+                        best++;
+                    }
+                    
+                    // Unique when nothing outside best +- 1 comes within the ratio
+                    int threshold = bestCost + bestCost * UNIQUENESS_RATIO / 100;
+                    int close = 0;
+                    for (int d = 0; d < D; d++) {
+                        close += w[d] <= threshold;
+                    }
+                    for (int d = std::max(best - 1, 0); d <= std::min(best + 1, D - 1); d++) {
+                        close -= w[d] <= threshold;
+                    }
+                    
+                    // The whole block must also see a right-image partner
+                    bool valid = close == 0 && best <= x - h;
+                    
+                    if (!valid) {
+                        out[x] = static_cast<short>(INVALID_DISPARITY);
+                        continue;
+                    }
+                    
+                    int value = best * DISP_SCALE;
+                    if (best > 0 && best < D - 1) {
+                        int prev = winSum[best - 1];
+                        int next = winSum[best + 1];
+                        int denom = prev + next - 2 * bestCost;
+                        if (denom > 0) {
+                            value += ((prev - next) * DISP_SCALE + denom) / (2 * denom);
+                        }
+                    }
+                    out[x] = static_cast<short>(value);
+                }
+            }
+            
+            // Slide the column sums down one row
+            if (y + 1 < rows.end) {
+                int removed = clampRow(y - h);
+                int added = clampRow(y + h + 1);
+                detail::accumulateRow<NDISP, false>(left.ptr<uchar>(removed), right.ptr<uchar>(removed),
+                                                    width, D, colSum.data());
+                detail::accumulateRow<NDISP, true>(left.ptr<uchar>(added), right.ptr<uchar>(added),
+                                                   width, D, colSum.data());
+            }
+        }
+    }
+    
+    using RowKernel = void (*)(const cv::Mat&, const cv::Mat&, cv::Mat&, int, int, const cv::Range&);
+    
+    // Compile-time specialization for block sizes 3/5/7/15/21/25 and 32/48/64/96/128
+    // disparities, or nullptr when the shape has none
+    RowKernel specializedKernel(int blockSize, int numDisparities);
+    
+    // Prefilter, then match row bands in parallel; the generic kernel is used when
+    // useSpecialized is false or no specialization exists for the shape
+    void computeDisparity(const cv::Mat& leftGray, const cv::Mat& rightGray, cv::Mat& disparity,
+                          int blockSize, int numDisparities, bool useSpecialized = true);
+    
+    // cv::StereoMatcher front end so the SAD kernels plug into the existing pipeline
+    // (algorithm 3). minDisparity is fixed at 0 and disp12MaxDiff is not applied.
+    class SadBlockMatcher : public cv::StereoMatcher {
+    public:
+        SadBlockMatcher(int numDisparities, int blockSize);
+        
+        void compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) override;
+        
+        int getMinDisparity() const override { return 0; }
+        void setMinDisparity(int) override {}
+        int getNumDisparities() const override { return numDisparities; }
+        void setNumDisparities(int value) override { numDisparities = value; }
+        int getBlockSize() const override { return blockSize; }
+        void setBlockSize(int value) override { blockSize = value; }
+        int getSpeckleWindowSize() const override { return speckleWindowSize; }
+        void setSpeckleWindowSize(int value) override { speckleWindowSize = value; }
+        int getSpeckleRange() const override { return speckleRange; }
+        void setSpeckleRange(int value) override { speckleRange = value; }
+        int getDisp12MaxDiff() const override { return disp12MaxDiff; }
+        void setDisp12MaxDiff(int value) override { disp12MaxDiff = value; }
+        
+    private:
+        int numDisparities;
+        int blockSize;
+        int speckleWindowSize;
+        int speckleRange;
+        int disp12MaxDiff;
+    };
+}
\ No newline at end of file
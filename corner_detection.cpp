@@ -1,4 +1,5 @@
 #include "corner_detection.h"
+#include "image_io.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <fstream>
@@ -6,9 +7,117 @@
 namespace fs = std::filesystem;
 #include <iomanip>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
 
 namespace CornerDetection {
 
+// corners.bin layout (little endian, native float):
+//   char[4] "CSET", uint32 version, int32 boardWidth, boardHeight, imageWidth, imageHeight,
+//   uint32 viewCount, then per view: int32 imageIndex, uint32 pointCount, float[2 * pointCount]
+static const char kCornerSetMagic[4] = {'C', 'S', 'E', 'T'};
+static const uint32_t kCornerSetVersion = 1;
+
+// Detection cache entry <key>.corners: char[4] "CDET", uint32 version, int32 found,
+//   int32 imageWidth, imageHeight, uint32 pointCount, float[2 * pointCount].
+// The key hashes the encoded image bytes together with the board parameters; bump the
+// version whenever detection or refinement settings change so stale entries are ignored.
+static const char kDetectionCacheMagic[4] = {'C', 'D', 'E', 'T'};
+static const uint32_t kDetectionCacheVersion = 1;
+
+template <typename T>
+static void appendPod(std::vector<char>& buffer, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool readPod(const std::vector<char>& buffer, size_t& offset, T& value) {
+    if (offset + sizeof(T) > buffer.size()) {
+        return false;
+    }
+    std::memcpy(&value, buffer.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+struct CachedDetection {
+    bool found;
+    cv::Size imageSize;
+    std::vector<cv::Point2f> corners;
+};
+
+static bool detectionCacheKey(const std::string& imageFile, int boardWidth, int boardHeight,
+                              float scaleFactor, uint64_t& key) {
+    uint64_t contentHash = 0;
+    if (!ImageIO::hashFile(imageFile, contentHash)) {
+        return false;
+    }
+    
+    std::vector<char> params;
+    appendPod(params, kDetectionCacheVersion);
+    appendPod(params, static_cast<int32_t>(boardWidth));
+    appendPod(params, static_cast<int32_t>(boardHeight));
+    appendPod(params, scaleFactor);
+    key = ImageIO::hashBytes(params.data(), params.size(), contentHash);
+    return true;
+}
+
+static bool loadCachedDetection(const std::string& entryFile, CachedDetection& entry) {
+    std::ifstream file(entryFile, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) ||
+        buffer.size() < 4 || std::memcmp(buffer.data(), kDetectionCacheMagic, 4) != 0) {
+        return false;
+    }
+    
+    size_t offset = 4;
+    uint32_t version = 0, pointCount = 0;
+    int32_t found = 0, imageWidth = 0, imageHeight = 0;
+    if (!readPod(buffer, offset, version) || version != kDetectionCacheVersion ||
+        !readPod(buffer, offset, found) || !readPod(buffer, offset, imageWidth) ||
+        !readPod(buffer, offset, imageHeight) || !readPod(buffer, offset, pointCount) ||
+        offset + pointCount * sizeof(cv::Point2f) != buffer.size()) {
+        return false;
+    }
+    
+    entry.found = found != 0;
+    entry.imageSize = cv::Size(imageWidth, imageHeight);
+    entry.corners.resize(pointCount);
+    std::memcpy(entry.corners.data(), buffer.data() + offset, pointCount * sizeof(cv::Point2f));
+    return true;
+}
+
+static bool saveCachedDetection(const std::string& entryFile, const CachedDetection& entry) {
+    std::vector<char> buffer;
+    buffer.insert(buffer.end(), kDetectionCacheMagic, kDetectionCacheMagic + 4);
+    appendPod(buffer, kDetectionCacheVersion);
+    appendPod(buffer, static_cast<int32_t>(entry.found ? 1 : 0));
+    appendPod(buffer, static_cast<int32_t>(entry.imageSize.width));
+    appendPod(buffer, static_cast<int32_t>(entry.imageSize.height));
+    appendPod(buffer, static_cast<uint32_t>(entry.corners.size()));
+    const char* points = reinterpret_cast<const char*>(entry.corners.data());
+    buffer.insert(buffer.end(), points, points + entry.corners.size() * sizeof(cv::Point2f));
+    
+    // Written under a temporary name so an interrupted run never leaves a truncated entry
+    std::string tempFile = entryFile + ".tmp";
+    {
+        std::ofstream file(tempFile, std::ios::binary);
+        if (!file.is_open() || !file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(tempFile, entryFile, error);
+    return !error;
+}
+
 bool detectChessboardCorners(const cv::Mat& image, int boardWidth, int boardHeight, 
                             std::vector<cv::Point2f>& corners) {
     cv::Size boardSize(boardWidth, boardHeight);
@@ -73,11 +182,17 @@ cv::Mat drawCornersWithNumbers(const cv::Mat& image, const std::vector<cv::Point
 }
 
 bool detectAndDrawCorners(const std::string& inputFolder, const std::string& outputFolder,
-                         int boardWidth, int boardHeight, float scaleFactor) {
+                         int boardWidth, int boardHeight, float scaleFactor,
+                         const std::string& cacheFolder, bool cacheAnnotated) {
     try {
         // Create output directory
         fs::create_directories(outputFolder);
         
+        bool useCache = !cacheFolder.empty();
+        if (useCache) {
+            fs::create_directories(cacheFolder);
+        }
+        
         // Get all image files
         std::vector<std::string> imageFiles;
         for (const auto& entry : fs::directory_iterator(inputFolder)) {
@@ -95,31 +210,88 @@ bool detectAndDrawCorners(const std::string& inputFolder, const std::string& out
             return false;
         }
         
+        // Sorted order keeps image indices stable so left/right corner sets pair up
+        std::sort(imageFiles.begin(), imageFiles.end());
+        
         int successCount = 0;
+        std::vector<CornerData> cornerData;
+        cv::Size imageSize;
+        int cacheHits = 0;
         
         for (size_t i = 0; i < imageFiles.size(); i++) {
-            cv::Mat image = cv::imread(imageFiles[i]);
-            if (image.empty()) {
-                std::cerr << "Cannot read image: " << imageFiles[i] << std::endl;
+            fs::path inputPath(imageFiles[i]);
+            std::string outputPath = outputFolder + "/corner_detected_" + inputPath.filename().string();
+            
+            std::string entryFile;
+            std::string annotatedFile;
+            CachedDetection entry;
+            bool cached = false;
+            uint64_t key = 0;
+            if (useCache && detectionCacheKey(imageFiles[i], boardWidth, boardHeight, scaleFactor, key)) {
+                entryFile = cacheFolder + "/" + ImageIO::hashToHex(key) + ".corners";
+                annotatedFile = cacheFolder + "/" + ImageIO::hashToHex(key) + inputPath.extension().string();
+                cached = loadCachedDetection(entryFile, entry);
+            }
+            
+            if (cached) {
+                cacheHits++;
+                imageSize = entry.imageSize;
+                
+                if (entry.found) {
+                    // Only the content-keyed drawing is trusted; without it the corners are redrawn
+                    // on a fresh decode, which still skips detection
+                    std::error_code error;
+                    if (fs::exists(annotatedFile)) {
+                        fs::copy_file(annotatedFile, outputPath, fs::copy_options::overwrite_existing, error);
+                    } else {
+                        cv::Mat image = ImageIO::loadImageScaled(imageFiles[i], scaleFactor);
+                        if (image.empty() || !cv::imwrite(outputPath, drawCornersWithNumbers(image, entry.corners,
+                                                                                             boardWidth, boardHeight))) {
+                            std::cerr << "Cannot redraw cached corners: " << outputPath << std::endl;
+                        } else if (cacheAnnotated) {
+                            fs::copy_file(outputPath, annotatedFile, fs::copy_options::overwrite_existing, error);
+                        }
+                    }
+                    if (error) {
+                        std::cerr << "Cannot restore cached drawing: " << outputPath << std::endl;
+                    }
+                    
+                    CornerData data;
+                    data.corners = entry.corners;
+                    data.detected = true;
+                    data.imageIndex = static_cast<int>(i) + 1;
+                    cornerData.push_back(data);
+                    successCount++;
+                    
+                    std::cout << "Corner detection cached for: " << inputPath.filename()
+                             << " (" << entry.corners.size() << " corners)" << std::endl;
+                } else {
+                    std::cerr << "Corner detection failed for: " << imageFiles[i] << " (cached)" << std::endl;
+                }
                 continue;
             }
             
-            // Resize if needed
-            if (scaleFactor != 1.0f) {
-                cv::resize(image, image, cv::Size(), scaleFactor, scaleFactor);
+            // Downscaled boards are decoded at reduced size instead of resized after a full decode
+            cv::Mat image = ImageIO::loadImageScaled(imageFiles[i], scaleFactor);
+            if (image.empty()) {
+                std::cerr << "Cannot read image: " << imageFiles[i] << std::endl;
+                continue;
             }
             
             std::vector<cv::Point2f> corners;
             bool detected = detectChessboardCorners(image, boardWidth, boardHeight, corners);
+            imageSize = image.size();
             
             if (detected) {
+                CornerData data;
+                data.corners = corners;
+                data.detected = true;
+                data.imageIndex = static_cast<int>(i) + 1;
+                cornerData.push_back(data);
+                
                 cv::Mat resultImage = drawCornersWithNumbers(image, corners, boardWidth, boardHeight);
                 
                 // Save result
-                fs::path inputPath(imageFiles[i]);
-                std::string outputFileName = "corner_detected_" + inputPath.filename().string();
-                std::string outputPath = outputFolder + "/" + outputFileName;
-                
                 cv::imwrite(outputPath, resultImage);
                 successCount++;
                 
@@ -128,11 +300,37 @@ bool detectAndDrawCorners(const std::string& inputFolder, const std::string& out
             } else {
                 std::cerr << "Corner detection failed for: " << imageFiles[i] << std::endl;
             }
+            
+            if (!entryFile.empty()) {
+                std::error_code error;
+                if (detected && cacheAnnotated) {
+                    fs::copy_file(outputPath, annotatedFile, fs::copy_options::overwrite_existing, error);
+                }
+                
+                CachedDetection fresh;
+                fresh.found = detected;
+                fresh.imageSize = imageSize;
+                if (detected) {
+                    fresh.corners = corners;
+                }
+                if (error || !saveCachedDetection(entryFile, fresh)) {
+                    std::cerr << "Cannot write detection cache entry: " << entryFile << std::endl;
+                }
+            }
+        }
+        
+        if (useCache) {
+            std::cout << "Corner detection cache: " << cacheHits << "/" << imageFiles.size()
+                      << " images reused from " << cacheFolder << std::endl;
         }
         
         std::cout << "Corner detection completed: " << successCount << "/" << imageFiles.size() 
                   << " images processed successfully" << std::endl;
         
+        if (successCount > 0) {
+            saveCornerSet(cornerData, boardWidth, boardHeight, imageSize, outputFolder + "/corners.bin");
+        }
+        
         return successCount > 0;
         
     } catch (const std::exception& e) {
@@ -150,7 +348,7 @@ bool saveCornerData(const std::vector<CornerData>& leftCorners,
         return false;
     }
     
-    file << "Image_Index, Camera, Point_Index, X, Y" << std::endl;
+    file << "Image_Index, Camera, Point_Index, X, Y\n";
     
     // Save left camera corners
     for (size_t i = 0; i < leftCorners.size(); i++) {
@@ -159,7 +357,7 @@ bool saveCornerData(const std::vector<CornerData>& leftCorners,
                 file << (i + 1) << ", left, " << (j + 1) << ", " 
                      << std::fixed << std::setprecision(4) 
                      << leftCorners[i].corners[j].x << ", " 
-                     << leftCorners[i].corners[j].y << std::endl;
+                     << leftCorners[i].corners[j].y << '\n';
             }
         }
     }
@@ -171,7 +369,7 @@ bool saveCornerData(const std::vector<CornerData>& leftCorners,
                 file << (i + 1) << ", right, " << (j + 1) << ", " 
                      << std::fixed << std::setprecision(4) 
                      << rightCorners[i].corners[j].x << ", " 
-                     << rightCorners[i].corners[j].y << std::endl;
+                     << rightCorners[i].corners[j].y << '\n';
             }
         }
     }
@@ -180,4 +378,144 @@ bool saveCornerData(const std::vector<CornerData>& leftCorners,
     return true;
 }
 
+bool saveCornerSet(const std::vector<CornerData>& corners, int boardWidth, int boardHeight,
+                  cv::Size imageSize, const std::string& outputFile) {
+    std::vector<char> buffer;
+    buffer.insert(buffer.end(), kCornerSetMagic, kCornerSetMagic + 4);
+    appendPod(buffer, kCornerSetVersion);
+    appendPod(buffer, static_cast<int32_t>(boardWidth));
+    appendPod(buffer, static_cast<int32_t>(boardHeight));
+    appendPod(buffer, static_cast<int32_t>(imageSize.width));
+    appendPod(buffer, static_cast<int32_t>(imageSize.height));
+    
+    uint32_t viewCount = 0;
+    for (const auto& data : corners) {
+        if (data.detected) {
+            viewCount++;
+        }
+    }
+    appendPod(buffer, viewCount);
+    
+    for (const auto& data : corners) {
+        if (!data.detected) {
+            continue;
+        }
+        appendPod(buffer, static_cast<int32_t>(data.imageIndex));
+        appendPod(buffer, static_cast<uint32_t>(data.corners.size()));
+        const char* points = reinterpret_cast<const char*>(data.corners.data());
+        buffer.insert(buffer.end(), points, points + data.corners.size() * sizeof(cv::Point2f));
+    }
+    
+    std::ofstream file(outputFile, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open file for writing: " << outputFile << std::endl;
+        return false;
+    }
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(file);
+}
+
+bool loadCornerSet(const std::string& inputFile, CornerSet& cornerSet) {
+    std::ifstream file(inputFile, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "Cannot open corner set: " << inputFile << std::endl;
+        return false;
+    }
+    
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+        std::cerr << "Cannot read corner set: " << inputFile << std::endl;
+        return false;
+    }
+    
+    size_t offset = 0;
+    uint32_t version = 0, viewCount = 0;
+    int32_t boardWidth = 0, boardHeight = 0, imageWidth = 0, imageHeight = 0;
+    if (buffer.size() < 4 || std::memcmp(buffer.data(), kCornerSetMagic, 4) != 0) {
+        std::cerr << "Not a corner set file: " << inputFile << std::endl;
+        return false;
+    }
+    offset = 4;
+    if (!readPod(buffer, offset, version) || version != kCornerSetVersion ||
+        !readPod(buffer, offset, boardWidth) || !readPod(buffer, offset, boardHeight) ||
+        !readPod(buffer, offset, imageWidth) || !readPod(buffer, offset, imageHeight) ||
+        !readPod(buffer, offset, viewCount)) {
+        std::cerr << "Unsupported or truncated corner set header: " << inputFile << std::endl;
+        return false;
+    }
+    
+    cornerSet.boardWidth = boardWidth;
+    cornerSet.boardHeight = boardHeight;
+    cornerSet.imageSize = cv::Size(imageWidth, imageHeight);
+    cornerSet.imageIndices.assign(viewCount, 0);
+    cornerSet.imagePoints.assign(viewCount, std::vector<cv::Point2f>());
+    
+    for (uint32_t v = 0; v < viewCount; v++) {
+        int32_t imageIndex = 0;
+        uint32_t pointCount = 0;
+        if (!readPod(buffer, offset, imageIndex) || !readPod(buffer, offset, pointCount) ||
+            offset + pointCount * sizeof(cv::Point2f) > buffer.size()) {
+            std::cerr << "Truncated corner set: " << inputFile << std::endl;
+            return false;
+        }
+        cornerSet.imageIndices[v] = imageIndex;
+        cornerSet.imagePoints[v].resize(pointCount);
+        std::memcpy(cornerSet.imagePoints[v].data(), buffer.data() + offset,
+                    pointCount * sizeof(cv::Point2f));
+        offset += pointCount * sizeof(cv::Point2f);
+    }
+    
+    return true;
+}
+
+std::vector<cv::Point3f> createObjectPoints(int boardWidth, int boardHeight, float squareSize) {
+    std::vector<cv::Point3f> objectPoints;
+    objectPoints.reserve(boardWidth * boardHeight);
+    for (int i = 0; i < boardHeight; i++) {
+        for (int j = 0; j < boardWidth; j++) {
+            objectPoints.emplace_back(j * squareSize, i * squareSize, 0.0f);
+        }
+    }
+    return objectPoints;
+}
+
+bool buildStereoPoints(const CornerSet& leftSet, const CornerSet& rightSet, float squareSize,
+                      std::vector<std::vector<cv::Point2f>>& leftPoints,
+                      std::vector<std::vector<cv::Point2f>>& rightPoints,
+                      std::vector<std::vector<cv::Point3f>>& objectPoints) {
+    if (leftSet.boardWidth != rightSet.boardWidth || leftSet.boardHeight != rightSet.boardHeight) {
+        std::cerr << "Corner sets use different board sizes" << std::endl;
+        return false;
+    }
+    
+    const size_t boardCorners = static_cast<size_t>(leftSet.boardWidth) * leftSet.boardHeight;
+    std::map<int, size_t> rightByIndex;
+    for (size_t i = 0; i < rightSet.imageIndices.size(); i++) {
+        rightByIndex[rightSet.imageIndices[i]] = i;
+    }
+    
+    const std::vector<cv::Point3f> board = createObjectPoints(leftSet.boardWidth, leftSet.boardHeight, squareSize);
+    leftPoints.clear();
+    rightPoints.clear();
+    objectPoints.clear();
+    
+    for (size_t i = 0; i < leftSet.imageIndices.size(); i++) {
+        auto it = rightByIndex.find(leftSet.imageIndices[i]);
+        if (it == rightByIndex.end()) {
+            continue;
+        }
+        const auto& left = leftSet.imagePoints[i];
+        const auto& right = rightSet.imagePoints[it->second];
+        if (left.size() != boardCorners || right.size() != boardCorners) {
+            continue;
+        }
+        leftPoints.push_back(left);
+        rightPoints.push_back(right);
+        objectPoints.push_back(board);
+    }
+    
+    return !leftPoints.empty();
+}
+
 }
\ No newline at end of file
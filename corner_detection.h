@@ -11,8 +11,21 @@ namespace CornerDetection {
         int imageIndex;
     };
     
+    // Refined corners of one camera as stored in the binary corners.bin file
+    struct CornerSet {
+        int boardWidth;
+        int boardHeight;
+        cv::Size imageSize;
+        std::vector<int> imageIndices;
+        std::vector<std::vector<cv::Point2f>> imagePoints;
+    };
+    
+    // With a cacheFolder, images whose contents and board parameters were seen before skip
+    // detection; cacheAnnotated also keeps the drawn result so they skip decoding as well,
+    // otherwise the cached corners are redrawn on a fresh decode
     bool detectAndDrawCorners(const std::string& inputFolder, const std::string& outputFolder,
-                             int boardWidth, int boardHeight, float scaleFactor = 1.0f);
+                             int boardWidth, int boardHeight, float scaleFactor = 1.0f,
+                             const std::string& cacheFolder = std::string(), bool cacheAnnotated = true);
     
     bool detectChessboardCorners(const cv::Mat& image, int boardWidth, int boardHeight, 
                                 std::vector<cv::Point2f>& corners);
@@ -23,4 +36,17 @@ namespace CornerDetection {
     bool saveCornerData(const std::vector<CornerData>& leftCorners, 
                        const std::vector<CornerData>& rightCorners,
                        const std::string& outputFile);
+    
+    bool saveCornerSet(const std::vector<CornerData>& corners, int boardWidth, int boardHeight,
+                      cv::Size imageSize, const std::string& outputFile);
+    
+    bool loadCornerSet(const std::string& inputFile, CornerSet& cornerSet);
+    
+    std::vector<cv::Point3f> createObjectPoints(int boardWidth, int boardHeight, float squareSize);
+    
+    // Pair left/right views by image index into the vectors used by calibrateFromPoints
+    bool buildStereoPoints(const CornerSet& leftSet, const CornerSet& rightSet, float squareSize,
+                          std::vector<std::vector<cv::Point2f>>& leftPoints,
+                          std::vector<std::vector<cv::Point2f>>& rightPoints,
+                          std::vector<std::vector<cv::Point3f>>& objectPoints);
 }
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "icp_registration.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+namespace IcpRegistration {
+
+namespace {
+
+bool isFinitePoint(const cv::Vec3f& p) {
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+cv::Vec3f transformPoint(const cv::Matx44d& T, const cv::Vec3f& p) {
+    return cv::Vec3f(static_cast<float>(T(0, 0) * p[0] + T(0, 1) * p[1] + T(0, 2) * p[2] + T(0, 3)),
+                     static_cast<float>(T(1, 0) * p[0] + T(1, 1) * p[1] + T(1, 2) * p[2] + T(1, 3)),
+                     static_cast<float>(T(2, 0) * p[0] + T(2, 1) * p[1] + T(2, 2) * p[2] + T(2, 3)));
+}
+
+// Small-motion update (rx, ry, rz, tx, ty, tz) as a rigid transform
+cv::Matx44d incrementTransform(const cv::Vec6d& x) {
+    cv::Matx33d R;
+    cv::Rodrigues(cv::Vec3d(x[0], x[1], x[2]), R);
+    cv::Matx44d T = cv::Matx44d::eye();
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            T(r, c) = R(r, c);
+        }
+        T(r, 3) = x[3 + r];
+    }
+    return T;
+}
+
+} // namespace
+
+PointCloud compactCloud(const cv::Mat& points3D, const cv::Mat& normals, const cv::Mat& disparity) {
+    CV_Assert(points3D.type() == CV_32FC3);
+    bool hasNormals = !normals.empty() && normals.type() == CV_32FC3 && normals.size() == points3D.size();
+    bool hasDisparity = !disparity.empty() && disparity.type() == CV_32FC1 && disparity.size() == points3D.size();
+    
+    PointCloud cloud;
+    for (int y = 0; y < points3D.rows; y++) {
+        const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+        const cv::Vec3f* n = hasNormals ? normals.ptr<cv::Vec3f>(y) : nullptr;
+        const float* d = hasDisparity ? disparity.ptr<float>(y) : nullptr;
+        for (int x = 0; x < points3D.cols; x++) {
+            if (!isFinitePoint(p[x]) || (d && d[x] <= 0.0f)) {
+                continue;
+            }
+            // Targets need a normal for every point
+            if (n && !isFinitePoint(n[x])) {
+                continue;
+            }
+            cloud.points.push_back(p[x]);
+            if (n) {
+                cloud.normals.push_back(n[x]);
+            }
+        }
+    }
+    return cloud;
+}
+
+int64_t VoxelHashIndex::cellKey(int x, int y, int z) const {
+    const int64_t mask = (int64_t(1) << 21) - 1;
+    return ((int64_t(x) & mask) << 42) | ((int64_t(y) & mask) << 21) | (int64_t(z) & mask);
+}
+
+void VoxelHashIndex::build(const std::vector<cv::Vec3f>& points, float cellSize) {
+    cloud = &points;
+    cell = cellSize;
+    cells.clear();
+    
+    // Counting sort of point indices by cell so each cell is one contiguous range
+    std::vector<int64_t> keys(points.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(points.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            const cv::Vec3f& p = points[i];
+            keys[i] = cellKey(static_cast<int>(std::floor(p[0] / cell)), static_cast<int>(std::floor(p[1] / cell)),
+                              static_cast<int>(std::floor(p[2] / cell)));
+        }
+    });
+    
+    for (size_t i = 0; i < keys.size(); i++) {
+        cells[keys[i]].second++;
+    }
+    int start = 0;
+    for (auto& entry : cells) {
+        entry.second.first = start;
+        start += entry.second.second;
+        entry.second.second = 0;
+    }
+    order.assign(points.size(), 0);
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto& range = cells[keys[i]];
+        order[range.first + range.second++] = static_cast<int>(i);
+    }
+}
+
+int VoxelHashIndex::nearest(const cv::Vec3f& query, float maxDistance) const {
+    int cx = static_cast<int>(std::floor(query[0] / cell));
+    int cy = static_cast<int>(std::floor(query[1] / cell));
+    int cz = static_cast<int>(std::floor(query[2] / cell));
+    
+    int best = -1;
+    float bestDistance = maxDistance * maxDistance;
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                auto it = cells.find(cellKey(cx + dx, cy + dy, cz + dz));
+                if (it == cells.end()) {
+                    continue;
+                }
+                for (int k = 0; k < it->second.second; k++) {
+                    int index = order[it->second.first + k];
+                    cv::Vec3f diff = (*cloud)[index] - query;
+                    float distance = diff.dot(diff);
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = index;
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+IcpResult alignPointToPlane(const PointCloud& source, const PointCloud& target,
+                            const cv::Matx44d& initial, const IcpParams& params) {
+    IcpResult result;
+    result.transform = initial;
+    result.finalRms = 0.0;
+    result.converged = false;
+    
+    if (source.points.empty() || target.points.empty() || target.normals.size() != target.points.size()) {
+        std::cerr << "ICP needs a non-empty source and a target with normals" << std::endl;
+        return result;
+    }
+    
+    const int levels = static_cast<int>(params.sampleStrides.size());
+    VoxelHashIndex index;
+    
+    for (int level = 0; level < levels; level++) {
+        int stride = std::max(params.sampleStrides[level], 1);
+        float maxDistance = params.maxCorrespondenceDistance * static_cast<float>(1 << (levels - 1 - level));
+        index.build(target.points, maxDistance);
+        
+        int samples = static_cast<int>((source.points.size() + stride - 1) / stride);
+        result.converged = false;
+        
+        for (int iteration = 0; iteration < params.iterationsPerLevel; iteration++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            
+            // Correspondences and the 6x6 normal equations, accumulated per worker
+            std::mutex accumulateMutex;
+            cv::Matx66d A = cv::Matx66d::zeros();
+            cv::Vec6d b(0, 0, 0, 0, 0, 0);
+            double squaredResidual = 0.0;
+            int correspondences = 0;
+            const cv::Matx44d transform = result.transform;
+            
+            cv::parallel_for_(cv::Range(0, samples), [&](const cv::Range& range) {
+                cv::Matx66d localA = cv::Matx66d::zeros();
+                cv::Vec6d localB(0, 0, 0, 0, 0, 0);
+                double localResidual = 0.0;
+                int localCount = 0;
+                
+                for (int s = range.start; s < range.end; s++) {
+                    cv::Vec3f p = transformPoint(transform, source.points[static_cast<size_t>(s) * stride]);
+                    int match = index.nearest(p, maxDistance);
+                    if (match < 0) {
+                        continue;
+                    }
+                    
+                    const cv::Vec3f& q = target.points[match];
+                    const cv::Vec3f& n = target.normals[match];
+                    double r = (p - q).dot(n);
+                    cv::Vec3f c = p.cross(n);
+                    cv::Vec6d J(c[0], c[1], c[2], n[0], n[1], n[2]);
+                    
+                    for (int i = 0; i < 6; i++) {
+                        for (int j = i; j < 6; j++) {
+                            localA(i, j) += J[i] * J[j];
+                        }
+                        localB[i] -= J[i] * r;
+                    }
+                    localResidual += r * r;
+                    localCount++;
+                }
+                
+                std::lock_guard<std::mutex> lock(accumulateMutex);
+                A += localA;
+                b += localB;
+                squaredResidual += localResidual;
+                correspondences += localCount;
+            });
+            
+            IterationStats stats;
+            stats.level = level;
+            stats.iteration = iteration;
+            stats.correspondences = correspondences;
+            stats.rmsResidual = correspondences > 0 ? std::sqrt(squaredResidual / correspondences) : 0.0;
+            result.finalRms = stats.rmsResidual;
+            
+            bool solved = false;
+            cv::Vec6d x;
+            if (correspondences >= 6) {
+                for (int i = 0; i < 6; i++) {
+                    for (int j = 0; j < i; j++) {
+                        A(i, j) = A(j, i);
+                    }
+                }
+                solved = cv::solve(A, b, x, cv::DECOMP_CHOLESKY);
+            }
+            if (solved) {
+                result.transform = incrementTransform(x) * result.transform;
+            }
+            
+            auto end = std::chrono::high_resolution_clock::now();
+            stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+            result.iterations.push_back(stats);
+            
+            if (!solved) {
+                break;
+            }
+            double rotation = cv::norm(cv::Vec3d(x[0], x[1], x[2]));
+            double translation = cv::norm(cv::Vec3d(x[3], x[4], x[5]));
+            if (rotation < params.convergenceRotation && translation < params.convergenceTranslation) {
+                result.converged = true;
+                break;
+            }
+        }
+    }
+    
+    return result;
+}
+
+void printIterations(const IcpResult& result) {
+    std::cout << std::left << std::setw(8) << "level" << std::setw(8) << "iter"
+              << std::setw(10) << "matches" << std::setw(14) << "rms" << "ms" << std::endl;
+    for (const auto& stats : result.iterations) {
+        std::cout << std::left << std::setw(8) << stats.level << std::setw(8) << stats.iteration
+                  << std::setw(10) << stats.correspondences
+                  << std::setw(14) << std::setprecision(6) << stats.rmsResidual
+                  << std::setprecision(3) << stats.milliseconds << std::endl;
+    }
+    std::cout << (result.converged ? "Converged" : "Not converged")
+              << ", final rms " << result.finalRms << std::endl;
+}
+
+}
\ No newline at end of file
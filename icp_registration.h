@@ -0,0 +1,67 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace IcpRegistration {
+    // Compact cloud: only valid points, normals optional (required for ICP targets)
+    struct PointCloud {
+        std::vector<cv::Vec3f> points;
+        std::vector<cv::Vec3f> normals;
+    };
+    
+    // Packs the finite points of an organized CV_32FC3 cloud (and matching normals, when
+    // given) into a compact buffer; pixels with non-positive disparity are skipped too
+    PointCloud compactCloud(const cv::Mat& points3D, const cv::Mat& normals = cv::Mat(),
+                            const cv::Mat& disparity = cv::Mat());
+    
+    // Uniform grid of cellSize buckets over a compact cloud; nearest() only visits the
+    // 27 cells around the query, so maxDistance should not exceed cellSize
+    class VoxelHashIndex {
+    public:
+        void build(const std::vector<cv::Vec3f>& points, float cellSize);
+        
+        // Index of the nearest point within maxDistance, -1 if none
+        int nearest(const cv::Vec3f& query, float maxDistance) const;
+        
+    private:
+        int64_t cellKey(int x, int y, int z) const;
+        
+        const std::vector<cv::Vec3f>* cloud = nullptr;
+        float cell = 1.0f;
+        std::unordered_map<int64_t, std::pair<int, int>> cells; // key -> (start, count) in order
+        std::vector<int> order;
+    };
+    
+    struct IcpParams {
+        std::vector<int> sampleStrides = {16, 4, 1}; // coarse-to-fine source subsampling
+        int iterationsPerLevel = 15;
+        float maxCorrespondenceDistance = 10.0f;     // finest level; doubles per coarser level
+        double convergenceRotation = 1e-5;           // radians per iteration
+        double convergenceTranslation = 1e-3;        // calibration units per iteration
+    };
+    
+    struct IterationStats {
+        int level;
+        int iteration;
+        int correspondences;
+        double rmsResidual;   // point-to-plane, before the update
+        double milliseconds;
+    };
+    
+    struct IcpResult {
+        cv::Matx44d transform;  // maps source into the target frame
+        std::vector<IterationStats> iterations;
+        double finalRms;
+        bool converged;
+    };
+    
+    // Point-to-plane ICP. Correspondence search and normal-equation accumulation run in
+    // parallel over source points; the target is indexed once per level in a voxel hash.
+    IcpResult alignPointToPlane(const PointCloud& source, const PointCloud& target,
+                                const cv::Matx44d& initial = cv::Matx44d::eye(),
+                                const IcpParams& params = IcpParams());
+    
+    void printIterations(const IcpResult& result);
+}
\ No newline at end of file
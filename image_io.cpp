@@ -0,0 +1,165 @@
+#include "image_io.h"
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace ImageIO {
+
+int reducedDecodeFactor(float scaleFactor) {
+    if (scaleFactor <= 0.0f || scaleFactor >= 1.0f) {
+        return 1;
+    }
+    
+    int reduction = 1;
+    while (reduction < 8 && 1.0f / (reduction * 2) >= scaleFactor) {
+        reduction *= 2;
+    }
+    return reduction;
+}
+
+int decodeFlags(bool grayscale, int reduction) {
+    switch (reduction) {
+        case 2:
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+    }
+}
+
+cv::Mat loadImage(const std::string& path, bool grayscale, int reduction) {
+    return cv::imread(path, decodeFlags(grayscale, reduction));
+}
+
+cv::Mat loadImageScaled(const std::string& path, float scaleFactor, bool grayscale) {
+    int reduction = reducedDecodeFactor(scaleFactor);
+    cv::Mat image = loadImage(path, grayscale, reduction);
+    if (image.empty()) {
+        return image;
+    }
+    
+    float remaining = scaleFactor * reduction;
+    if (scaleFactor > 0.0f && std::abs(remaining - 1.0f) > 1e-3f) {
+        cv::resize(image, image, cv::Size(), remaining, remaining,
+                   remaining < 1.0f ? cv::INTER_AREA : cv::INTER_LINEAR);
+    }
+    return image;
+}
+
+static const uint64_t kPrime1 = 11400714785074694791ULL;
+static const uint64_t kPrime2 = 14029467366897019727ULL;
+static const uint64_t kPrime3 = 1609587929392839161ULL;
+static const uint64_t kPrime4 = 9650029242287828579ULL;
+static const uint64_t kPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+    acc ^= hashRound(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
+    
+    if (size >= 32) {
+        // Four independent lanes keep the multiplier pipeline busy
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = hashRound(v1, read64(p));
+            v2 = hashRound(v2, read64(p + 8));
+            v3 = hashRound(v3, read64(p + 16));
+            v4 = hashRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+    
+    h += static_cast<uint64_t>(size);
+    
+    while (p + 8 <= end) {
+        h ^= hashRound(0, read64(p));
+        h = rotl64(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl64(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * kPrime5;
+        h = rotl64(h, 11) * kPrime1;
+        p++;
+    }
+    
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool hashFile(const std::string& path, uint64_t& hash, uint64_t seed) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!buffer.empty() && !file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+        return false;
+    }
+    
+    hash = hashBytes(buffer.data(), buffer.size(), seed);
+    return true;
+}
+
+std::string hashToHex(uint64_t hash) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(text);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ImageIO {
+    // Largest DCT-domain reduction (1, 2, 4 or 8) that does not go below the requested scale
+    int reducedDecodeFactor(float scaleFactor);
+    
+    int decodeFlags(bool grayscale, int reduction);
+    
+    // Decode with IMREAD_REDUCED_* / IMREAD_GRAYSCALE so only the needed planes are produced
+    cv::Mat loadImage(const std::string& path, bool grayscale = false, int reduction = 1);
+    
+    // Reduced decode followed by a resize for the remaining fraction of scaleFactor
+    cv::Mat loadImageScaled(const std::string& path, float scaleFactor, bool grayscale = false);
+    
+    // XXH64 of a byte range; hashing a file is several times cheaper than decoding it
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+    
+    // Hash of the encoded file contents, used as a cache key for results derived from it
+    bool hashFile(const std::string& path, uint64_t& hash, uint64_t seed = 0);
+    
+    std::string hashToHex(uint64_t hash);
+}
\ No newline at end of file
@@ -1,11 +1,51 @@
 #include "image_resize.h"
+#include "image_io.h"
+#include "output_writer.h"
+#include "task_pool.h"
+#include "thread_config.h"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
 namespace fs = std::filesystem;
 
 namespace ImageResize {
 
+namespace {
+
+std::vector<fs::path> listImages(const std::string& inputFolder) {
+    std::vector<fs::path> images;
+    for (const auto& entry : fs::directory_iterator(inputFolder)) {
+        if (entry.is_regular_file()) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            
+            if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
+                images.push_back(entry.path());
+            }
+        }
+    }
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+struct SlotRelease {
+    std::shared_ptr<std::atomic<int>> pending;
+    Threading::InFlightLimit* limit;
+    
+    ~SlotRelease() {
+        if (--*pending == 0) {
+            limit->release();
+        }
+    }
+};
+
+} // namespace
+
 cv::Mat resizeImage(const cv::Mat& image, float scaleFactor, int targetWidth, int targetHeight) {
     cv::Mat resized;
     
@@ -20,34 +60,134 @@ cv::Mat resizeImage(const cv::Mat& image, float scaleFactor, int targetWidth, in
     return resized;
 }
 
-bool resizeImages(const std::string& inputFolder, const std::string& outputFolder, 
-                 float scaleFactor, int targetWidth, int targetHeight) {
+std::vector<cv::Mat> loadPyramid(const std::string& path, const std::vector<int>& levels) {
+    std::vector<cv::Mat> pyramid;
+    if (levels.empty()) {
+        return pyramid;
+    }
+    
+    // The finest level comes straight from a reduced decode; coarser levels are
+    // area-averaged from the previous one instead of re-reading the source
+    cv::Mat current = ImageIO::loadImageScaled(path, 1.0f / levels[0]);
+    if (current.empty()) {
+        return pyramid;
+    }
+    pyramid.push_back(current);
+    
+    for (size_t i = 1; i < levels.size(); i++) {
+        double step = static_cast<double>(levels[i - 1]) / levels[i];
+        cv::Mat next;
+        cv::resize(pyramid.back(), next, cv::Size(), step, step, cv::INTER_AREA);
+        pyramid.push_back(next);
+    }
+    return pyramid;
+}
+
+bool resizeImages(const std::string& inputFolder, const std::string& outputFolder,
+                 const ResizeOptions& options) {
     try {
-        fs::create_directories(outputFolder);
+        std::vector<int> levels = options.pyramidLevels;
+        std::sort(levels.begin(), levels.end());
+        levels.erase(std::unique(levels.begin(), levels.end()), levels.end());
+        levels.erase(std::remove_if(levels.begin(), levels.end(), [](int level) { return level < 1; }),
+                     levels.end());
+        bool pyramidMode = !options.pyramidLevels.empty();
+        if (pyramidMode && levels.empty()) {
+            std::cerr << "Invalid pyramid levels" << std::endl;
+            return false;
+        }
         
-        int processedCount = 0;
+        std::vector<std::string> levelFolders;
+        if (pyramidMode) {
+            for (int level : levels) {
+                levelFolders.push_back(outputFolder + "/1_" + std::to_string(level));
+                fs::create_directories(levelFolders.back());
+            }
+        } else {
+            fs::create_directories(outputFolder);
+        }
+        
+        std::vector<fs::path> images = listImages(inputFolder);
+        
+        // Decodes and encodes share the process-wide pool, so its size bounds both stages
+        Threading::TaskPool& pool = Threading::sharedPool();
+        int maxInFlight = options.maxInFlight > 0 ? options.maxInFlight : 2 * pool.threadCount();
+        Threading::InFlightLimit inFlight(maxInFlight);
+        
+        OutputWriter::Writer& writer = OutputWriter::sharedWriter();
+        std::mutex futuresMutex;
+        OutputWriter::ArtifactFutures futures;
+        std::atomic<int> decodeFailures(0);
+        Threading::TaskGroup decoders(pool);
         
-        for (const auto& entry : fs::directory_iterator(inputFolder)) {
-            if (entry.is_regular_file()) {
-                std::string ext = entry.path().extension().string();
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        for (const auto& image : images) {
+            // Blocks here, not in a worker, so queued decodes cannot outrun the encoders
+            inFlight.acquire();
+            
+            decoders.post([&, image] {
+                std::vector<cv::Mat> outputs;
+                std::vector<std::string> paths;
+                std::string filename = image.filename().string();
                 
-                if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
-                    cv::Mat image = cv::imread(entry.path().string());
-                    if (!image.empty()) {
-                        cv::Mat resized = resizeImage(image, scaleFactor, targetWidth, targetHeight);
-                        
-                        std::string outputPath = outputFolder + "/" + entry.path().filename().string();
-                        if (cv::imwrite(outputPath, resized)) {
-                            processedCount++;
-                            std::cout << "Resized: " << entry.path().filename() << std::endl;
+                try {
+                    if (pyramidMode) {
+                        outputs = loadPyramid(image.string(), levels);
+                        for (const auto& folder : levelFolders) {
+                            paths.push_back(folder + "/" + filename);
                         }
+                    } else if (options.targetWidth > 0 && options.targetHeight > 0) {
+                        cv::Mat source = cv::imread(image.string());
+                        if (!source.empty()) {
+                            outputs.push_back(resizeImage(source, options.scaleFactor,
+                                                          options.targetWidth, options.targetHeight));
+                        }
+                        paths.push_back(outputFolder + "/" + filename);
+                    } else {
+                        // Reduced decode already yields the scaled image
+                        outputs.push_back(ImageIO::loadImageScaled(image.string(), options.scaleFactor));
+                        paths.push_back(outputFolder + "/" + filename);
                     }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error resizing " << image << ": " << e.what() << std::endl;
+                    outputs.clear();
+                }
+                
+                if (outputs.empty() || outputs[0].empty()) {
+                    std::cerr << "Cannot resize image: " << image << std::endl;
+                    decodeFailures++;
+                    inFlight.release();
+                    return;
+                }
+                
+                // The slot is returned once the last encode of this image has finished
+                auto pending = std::make_shared<std::atomic<int>>(static_cast<int>(outputs.size()));
+                Threading::InFlightLimit* limit = &inFlight;
+                for (size_t i = 0; i < outputs.size(); i++) {
+                    cv::Mat resized = outputs[i];
+                    std::string outputPath = paths[i];
+                    auto future = writer.writeTask(outputPath, [resized, outputPath, pending, limit] {
+                        SlotRelease done{pending, limit};
+                        return cv::imwrite(outputPath, resized);
+                    });
+                    
+                    std::lock_guard<std::mutex> lock(futuresMutex);
+                    futures.push_back(std::move(future));
                 }
+            });
+        }
+        
+        decoders.wait();
+        std::vector<OutputWriter::ArtifactStatus> artifacts = OutputWriter::collect(futures);
+        
+        int processedCount = 0;
+        for (const auto& artifact : artifacts) {
+            if (artifact.success) {
+                processedCount++;
             }
         }
         
-        std::cout << "Image resize completed: " << processedCount << " images processed" << std::endl;
+        std::cout << "Image resize completed: " << processedCount << " images written from "
+                  << images.size() - decodeFailures.load() << " sources" << std::endl;
         return processedCount > 0;
         
     } catch (const std::exception& e) {
@@ -56,4 +196,20 @@ bool resizeImages(const std::string& inputFolder, const std::string& outputFolde
     }
 }
 
+bool resizeImages(const std::string& inputFolder, const std::string& outputFolder, 
+                 float scaleFactor, int targetWidth, int targetHeight) {
+    ResizeOptions options;
+    options.scaleFactor = scaleFactor;
+    options.targetWidth = targetWidth;
+    options.targetHeight = targetHeight;
+    return resizeImages(inputFolder, outputFolder, options);
+}
+
+bool buildPyramids(const std::string& inputFolder, const std::string& outputFolder,
+                  const std::vector<int>& levels) {
+    ResizeOptions options;
+    options.pyramidLevels = levels;
+    return resizeImages(inputFolder, outputFolder, options);
+}
+
 }
\ No newline at end of file
@@ -1,11 +1,33 @@
 #pragma once
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
 
 namespace ImageResize {
+    struct ResizeOptions {
+        float scaleFactor = 1.0f;
+        int targetWidth = 0;
+        int targetHeight = 0;
+        // Pyramid mode, e.g. {2, 4, 8}: each source is decoded once and written to
+        // outputFolder/1_2, 1_4, 1_8; scaleFactor and target size are ignored
+        std::vector<int> pyramidLevels;
+        int maxInFlight = 0;  // decoded images waiting to be encoded, 0 = 2 * shared pool size
+    };
+    
+    // Decode/resize run on Threading::sharedPool() while earlier images are encoded on the
+    // output writer
+    bool resizeImages(const std::string& inputFolder, const std::string& outputFolder,
+                     const ResizeOptions& options);
+    
     bool resizeImages(const std::string& inputFolder, const std::string& outputFolder, 
                      float scaleFactor = 1.0f, int targetWidth = 0, int targetHeight = 0);
     
+    bool buildPyramids(const std::string& inputFolder, const std::string& outputFolder,
+                      const std::vector<int>& levels = {2, 4, 8});
+    
     cv::Mat resizeImage(const cv::Mat& image, float scaleFactor = 1.0f, 
                        int targetWidth = 0, int targetHeight = 0);
+    
+    // Successive INTER_AREA reductions from a single (reduced) decode, finest level first
+    std::vector<cv::Mat> loadPyramid(const std::string& path, const std::vector<int>& levels);
 }
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "latency_budget.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+
+namespace LatencyBudget {
+
+std::vector<StereoReconstruction::MatcherConfig> candidateConfigs() {
+    std::vector<StereoReconstruction::MatcherConfig> configs;
+    const int downscales[] = {1, 2, 4};
+    const int disparityRanges[] = {64, 128};
+    const int sgbmBlocks[] = {3, 5, 7};
+    const int bmBlocks[] = {15, 21};
+    
+    for (int downscale : downscales) {
+        for (int numDisparities : disparityRanges) {
+            for (int blockSize : sgbmBlocks) {
+                configs.push_back({1, blockSize, numDisparities, downscale});
+            }
+            for (int blockSize : bmBlocks) {
+                configs.push_back({0, blockSize, numDisparities, downscale});
+            }
+        }
+    }
+    return configs;
+}
+
+HostProfile profileHost(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight, int runs) {
+    HostProfile profile;
+    profile.imageSize = rectifiedLeft.size();
+    
+    // Central crop of roughly a quarter of the frame keeps the run short
+    int cropWidth = std::max(std::min(rectifiedLeft.cols, 512), rectifiedLeft.cols / 2);
+    int cropHeight = std::max(std::min(rectifiedLeft.rows, 256), rectifiedLeft.rows / 2);
+    cv::Rect crop((rectifiedLeft.cols - cropWidth) / 2, (rectifiedLeft.rows - cropHeight) / 2,
+                  cropWidth, cropHeight);
+    cv::Mat left = rectifiedLeft(crop), right = rectifiedRight(crop);
+    double areaScale = static_cast<double>(profile.imageSize.area()) / crop.area();
+    
+    // The leftmost numDisparities columns (plus half a block) can never match, so validity is
+    // scored on the columns every candidate can match; otherwise wider ranges score lower
+    std::vector<StereoReconstruction::MatcherConfig> configs = candidateConfigs();
+    int margin = 0;
+    for (const auto& config : configs) {
+        margin = std::max(margin, config.numDisparities + config.blockSize * config.downscale / 2);
+    }
+    cv::Range scoredColumns(margin < left.cols ? margin : 0, left.cols);
+    
+    runs = std::max(1, runs);
+    for (const auto& config : configs) {
+        // The warm-up run absorbs first-touch allocation and cold caches
+        cv::Mat disparity = StereoReconstruction::computeDepthMap(left, right, config);
+        
+        std::vector<double> times;
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            disparity = StereoReconstruction::computeDepthMap(left, right, config);
+            auto end = std::chrono::high_resolution_clock::now();
+            times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        
+        ProfileEntry entry;
+        entry.config = config;
+        entry.milliseconds = times[times.size() / 2] * areaScale;
+        
+        cv::Mat scored = disparity.colRange(scoredColumns);
+        double validRatio = static_cast<double>(cv::countNonZero(scored >= 0)) / scored.total();
+        double algorithmWeight = (config.algorithm == 1) ? 1.0 : 0.7;
+        entry.qualityScore = validRatio * algorithmWeight / config.downscale;
+        profile.entries.push_back(entry);
+        
+        std::cout << "Profiled algorithm " << config.algorithm << " block " << config.blockSize
+                  << " disparities " << config.numDisparities << " downscale 1/" << config.downscale
+                  << ": " << entry.milliseconds << " ms, score " << entry.qualityScore << std::endl;
+    }
+    
+    return profile;
+}
+
+bool saveProfile(const HostProfile& profile, const std::string& filename) {
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        std::cerr << "Cannot open file for writing: " << filename << std::endl;
+        return false;
+    }
+    
+    fs << "Image_Size" << profile.imageSize;
+    fs << "Entries" << "[";
+    for (const auto& entry : profile.entries) {
+        fs << "{" << "Algorithm" << entry.config.algorithm
+           << "Block_Size" << entry.config.blockSize
+           << "Num_Disparities" << entry.config.numDisparities
+           << "Downscale" << entry.config.downscale
+           << "Milliseconds" << entry.milliseconds
+           << "Quality_Score" << entry.qualityScore << "}";
+    }
+    fs << "]";
+    
+    fs.release();
+    return true;
+}
+
+bool loadProfile(const std::string& filename, HostProfile& profile) {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        return false;
+    }
+    
+    fs["Image_Size"] >> profile.imageSize;
+    profile.entries.clear();
+    cv::FileNode entries = fs["Entries"];
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        ProfileEntry entry;
+        entry.config.algorithm = (int)(*it)["Algorithm"];
+        entry.config.blockSize = (int)(*it)["Block_Size"];
+        entry.config.numDisparities = (int)(*it)["Num_Disparities"];
+        entry.config.downscale = (int)(*it)["Downscale"];
+        entry.milliseconds = (double)(*it)["Milliseconds"];
+        entry.qualityScore = (double)(*it)["Quality_Score"];
+        profile.entries.push_back(entry);
+    }
+    
+    fs.release();
+    return !profile.entries.empty();
+}
+
+BudgetController::BudgetController(const HostProfile& hostProfile, double budgetMilliseconds)
+    : profile(hostProfile), budget(budgetMilliseconds), drift(1.0), current(0) {
+    CV_Assert(!profile.entries.empty());
+    select(profile.imageSize);
+}
+
+const StereoReconstruction::MatcherConfig& BudgetController::currentConfig() const {
+    return profile.entries[current].config;
+}
+
+double BudgetController::expectedMilliseconds(const ProfileEntry& entry, cv::Size imageSize) const {
+    double areaScale = static_cast<double>(imageSize.area()) / std::max(1, profile.imageSize.area());
+    return entry.milliseconds * areaScale * drift;
+}
+
+void BudgetController::reportTiming(double milliseconds, cv::Size imageSize) {
+    double expected = expectedMilliseconds(profile.entries[current], imageSize) / drift;
+    if (expected <= 0.0) {
+        return;
+    }
+    
+    // Exponential smoothing so a single slow pair does not flip the configuration
+    drift = 0.8 * drift + 0.2 * (milliseconds / expected);
+    select(imageSize);
+}
+
+void BudgetController::setBudget(double budgetMilliseconds) {
+    budget = budgetMilliseconds;
+    select(profile.imageSize);
+}
+
+void BudgetController::select(cv::Size imageSize) {
+    size_t best = 0;
+    bool found = false;
+    
+    for (size_t i = 0; i < profile.entries.size(); i++) {
+        const ProfileEntry& entry = profile.entries[i];
+        if (expectedMilliseconds(entry, imageSize) > budget) {
+            continue;
+        }
+        if (!found || entry.qualityScore > profile.entries[best].qualityScore) {
+            best = i;
+            found = true;
+        }
+    }
+    
+    // Nothing fits: fall back to the fastest configuration
+    if (!found) {
+        for (size_t i = 1; i < profile.entries.size(); i++) {
+            if (profile.entries[i].milliseconds < profile.entries[best].milliseconds) {
+                best = i;
+            }
+        }
+    }
+    
+    current = best;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+namespace LatencyBudget {
+    struct ProfileEntry {
+        StereoReconstruction::MatcherConfig config;
+        double milliseconds;  // measured matching time, scaled to the profile image size
+        double qualityScore;  // valid disparity ratio (on columns all candidates can match)
+                              // weighted by resolution and algorithm
+    };
+    
+    struct HostProfile {
+        cv::Size imageSize;
+        std::vector<ProfileEntry> entries;
+    };
+    
+    // Algorithm, block size, disparity range and downscale combinations that are profiled
+    std::vector<StereoReconstruction::MatcherConfig> candidateConfigs();
+    
+    // One-off profiling on a central crop of a rectified pair: each candidate gets a warm-up
+    // run and the median of runs timed runs; times are extrapolated to the full frame by area
+    HostProfile profileHost(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight, int runs = 3);
+    
+    bool saveProfile(const HostProfile& profile, const std::string& filename);
+    
+    bool loadProfile(const std::string& filename, HostProfile& profile);
+    
+    // Picks the highest quality configuration whose expected time fits the per-pair budget
+    // and re-selects when measured matching times drift from the profile
+    class BudgetController {
+    public:
+        BudgetController(const HostProfile& hostProfile, double budgetMilliseconds);
+        
+        const StereoReconstruction::MatcherConfig& currentConfig() const;
+        
+        double expectedMilliseconds(const ProfileEntry& entry, cv::Size imageSize) const;
+        
+        // Feed back the measured matching time of the current configuration
+        void reportTiming(double milliseconds, cv::Size imageSize);
+        
+        void setBudget(double budgetMilliseconds);
+        
+    private:
+        void select(cv::Size imageSize);
+        
+        HostProfile profile;
+        double budget;
+        double drift;  // smoothed ratio of measured to profiled time
+        size_t current;
+    };
+}
\ No newline at end of file
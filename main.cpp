@@ -27,16 +27,18 @@ int main() {
     }
     
     // Perform corner detection on calibration images
+    // 未变化的标定图像直接复用缓存中的角点, 跳过解码与检测
+    std::string cornerCacheFolder = "/home/runner/work/mat_VC2022_2Dto3D/mat_VC2022_2Dto3D/output/corner_cache";
     bool leftSuccess = CornerDetection::detectAndDrawCorners(
         leftInputFolder,
         "/home/runner/work/mat_VC2022_2Dto3D/mat_VC2022_2Dto3D/output/left_corners",
-        9, 6, 1.0f
+        9, 6, 1.0f, cornerCacheFolder
     );
     
     bool rightSuccess = CornerDetection::detectAndDrawCorners(
         rightInputFolder, 
         "/home/runner/work/mat_VC2022_2Dto3D/mat_VC2022_2Dto3D/output/right_corners",
-        9, 6, 1.0f
+        9, 6, 1.0f, cornerCacheFolder
     );
     
     if (!leftSuccess || !rightSuccess) {
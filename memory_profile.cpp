@@ -0,0 +1,215 @@
+#include "memory_profile.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace MemoryProfile {
+
+namespace {
+
+// Forwards to OpenCV's standard allocator and counts what passes through it.
+// Buffers are re-tagged with this allocator so their release is seen as well.
+class CountingAllocator : public cv::MatAllocator {
+public:
+    CountingAllocator() : base(cv::Mat::getStdAllocator()), allocations(0), bytes(0), live(0), peak(0) {}
+    
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        cv::UMatData* u = base->allocate(dims, sizes, type, data0, step, flags, usageFlags);
+        if (u) {
+            u->currAllocator = this;
+            if (!data0) {
+                allocations++;
+                bytes += u->size;
+                uint64_t now = live += u->size;
+                uint64_t previous = peak.load();
+                while (now > previous && !peak.compare_exchange_weak(previous, now)) {}
+            }
+        }
+        return u;
+    }
+    
+    bool allocate(cv::UMatData* u, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override {
+        return base->allocate(u, accessflags, usageFlags);
+    }
+    
+    void deallocate(cv::UMatData* u) const override {
+        if (!u) {
+            return;
+        }
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+            live -= u->size;
+        }
+        u->currAllocator = base;
+        base->deallocate(u);
+    }
+    
+    // Restarts the live-bytes high-water mark at the current level
+    void resetPeak() { peak = live.load(); }
+    
+    const cv::MatAllocator* base;
+    mutable std::atomic<uint64_t> allocations;
+    mutable std::atomic<uint64_t> bytes;
+    mutable std::atomic<uint64_t> live;
+    mutable std::atomic<uint64_t> peak;
+};
+
+// Never destroyed: buffers allocated while tracking may outlive every tracker
+CountingAllocator& countingAllocator() {
+    static CountingAllocator* allocator = new CountingAllocator();
+    return *allocator;
+}
+
+std::mutex installMutex;
+int installCount = 0;
+cv::MatAllocator* previousAllocator = nullptr;
+
+void installAllocator() {
+    std::lock_guard<std::mutex> lock(installMutex);
+    if (installCount++ == 0) {
+        previousAllocator = cv::Mat::getDefaultAllocator();
+        cv::Mat::setDefaultAllocator(&countingAllocator());
+    }
+}
+
+void uninstallAllocator() {
+    std::lock_guard<std::mutex> lock(installMutex);
+    if (--installCount == 0) {
+        cv::Mat::setDefaultAllocator(previousAllocator);
+    }
+}
+
+#ifndef _WIN32
+// Reads a "VmRSS:" / "VmHWM:" line (in kB) from /proc/self/status
+uint64_t readStatusField(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size(), field) == 0) {
+            std::istringstream iss(line.substr(field.size()));
+            uint64_t kilobytes = 0;
+            iss >> kilobytes;
+            return kilobytes * 1024;
+        }
+    }
+    return 0;
+}
+#endif
+
+} // namespace
+
+uint64_t currentRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#else
+    return readStatusField("VmRSS:");
+#endif
+}
+
+uint64_t peakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    return readStatusField("VmHWM:");
+#endif
+}
+
+StageTracker::StageTracker(bool enabled)
+    : active(enabled), startAllocations(0), startBytes(0) {
+    if (!active) {
+        return;
+    }
+    installAllocator();
+    CountingAllocator& allocator = countingAllocator();
+    allocator.resetPeak();
+    startAllocations = allocator.allocations;
+    startBytes = allocator.bytes;
+}
+
+StageTracker::~StageTracker() {
+    if (active) {
+        uninstallAllocator();
+    }
+}
+
+void StageTracker::mark(const std::string& stage) {
+    if (!active) {
+        return;
+    }
+    CountingAllocator& allocator = countingAllocator();
+    uint64_t allocations = allocator.allocations;
+    uint64_t bytes = allocator.bytes;
+    
+    StageMemory memory;
+    memory.stage = stage;
+    memory.allocations = allocations - startAllocations;
+    memory.bytesAllocated = bytes - startBytes;
+    memory.peakLiveBytes = allocator.peak;
+    memory.rssBytes = currentRssBytes();
+    memory.peakRssBytes = peakRssBytes();
+    recorded.push_back(memory);
+    
+    startAllocations = allocations;
+    startBytes = bytes;
+    allocator.resetPeak();
+}
+
+bool saveStageMemory(const std::vector<StageMemory>& stages, const std::string& filename) {
+    try {
+        cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            std::cerr << "Cannot open file for writing: " << filename << std::endl;
+            return false;
+        }
+        
+        // FileStorage has no 64-bit integers; byte counts are stored as doubles
+        fs << "stages" << "[";
+        for (const auto& memory : stages) {
+            fs << "{" << "stage" << memory.stage
+               << "allocations" << static_cast<double>(memory.allocations)
+               << "bytesAllocated" << static_cast<double>(memory.bytesAllocated)
+               << "peakLiveBytes" << static_cast<double>(memory.peakLiveBytes)
+               << "rssBytes" << static_cast<double>(memory.rssBytes)
+               << "peakRssBytes" << static_cast<double>(memory.peakRssBytes) << "}";
+        }
+        fs << "]";
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving memory profile: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void printStageMemory(const std::vector<StageMemory>& stages) {
+    const double mb = 1024.0 * 1024.0;
+    std::cout << std::left << std::setw(14) << "stage" << std::right
+              << std::setw(10) << "allocs" << std::setw(14) << "alloc MB"
+              << std::setw(14) << "peak Mat MB" << std::setw(12) << "RSS MB"
+              << std::setw(14) << "peak RSS MB" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& memory : stages) {
+        std::cout << std::left << std::setw(14) << memory.stage << std::right
+                  << std::setw(10) << memory.allocations
+                  << std::setw(14) << memory.bytesAllocated / mb
+                  << std::setw(14) << memory.peakLiveBytes / mb
+                  << std::setw(12) << memory.rssBytes / mb
+                  << std::setw(14) << memory.peakRssBytes / mb << std::endl;
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MemoryProfile {
+    struct StageMemory {
+        std::string stage;
+        uint64_t allocations;     // cv::Mat buffers allocated during the stage
+        uint64_t bytesAllocated;  // total size of those buffers
+        uint64_t peakLiveBytes;   // high-water mark of live cv::Mat bytes during the stage
+        uint64_t rssBytes;        // resident set size when the stage ended
+        uint64_t peakRssBytes;    // process peak resident set size so far
+    };
+    
+    // Resident set size of this process, 0 where it cannot be sampled
+    uint64_t currentRssBytes();
+    uint64_t peakRssBytes();
+    
+    // Records per-stage allocation counts and RSS. While at least one enabled tracker
+    // is alive, a counting allocator wraps OpenCV's default one; the counters are
+    // process-wide, so stages of concurrent reconstructions are attributed together.
+    class StageTracker {
+    public:
+        explicit StageTracker(bool enabled);
+        ~StageTracker();
+        
+        StageTracker(const StageTracker&) = delete;
+        StageTracker& operator=(const StageTracker&) = delete;
+        
+        // Closes the stage that started at the previous mark (or construction)
+        void mark(const std::string& stage);
+        
+        bool enabled() const { return active; }
+        const std::vector<StageMemory>& stages() const { return recorded; }
+        
+    private:
+        bool active;
+        uint64_t startAllocations;
+        uint64_t startBytes;
+        std::vector<StageMemory> recorded;
+    };
+    
+    // Machine-readable report (.json / .yml through cv::FileStorage)
+    bool saveStageMemory(const std::vector<StageMemory>& stages, const std::string& filename);
+    
+    void printStageMemory(const std::vector<StageMemory>& stages);
+}
\ No newline at end of file
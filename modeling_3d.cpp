@@ -1,6 +1,7 @@
 #include "modeling_3d.h"
 #include "stereo_reconstruction.h"
 #include "stereo_calibration.h"
+#include "output_writer.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <chrono>
@@ -30,11 +31,15 @@ ModelingResult performModeling(const ModelingParams& params) {
         reconParams.calibrationFile = params.calibrationFile;
         reconParams.quality = params.qualityLevel;
         reconParams.algorithm = 1; // SGBM
-        reconParams.useColorTexture = true;
+        // 仅在导出彩色点云或矫正图时解码彩色图像
+        reconParams.useColorTexture = params.generatePointCloud || params.generateRectifiedImages;
         reconParams.maxDepth = 10.0f;
         reconParams.minDepth = 0.1f;
         reconParams.outputFormat = 0; // PLY
         reconParams.postProcessing = 2; // 双边滤波
+        reconParams.trackMemory = params.trackMemory;
+        reconParams.removeOutliers = params.removeOutliers;
+        reconParams.computeNormals = params.computeNormals;
         
         StereoReconstruction::ReconstructionOutput reconResult = 
             StereoReconstruction::performStereoReconstruction(reconParams);
@@ -44,38 +49,68 @@ ModelingResult performModeling(const ModelingParams& params) {
             return result;
         }
         
+        // 重建之后的复制和保存阶段接在重建各阶段的统计之后
+        result.stageMemory = reconResult.stageMemory;
+        MemoryProfile::StageTracker memoryTracker(params.trackMemory);
+        
         // 复制结果
         result.depthMap = reconResult.depthMap.clone();
         result.residualMap = reconResult.residualMap.clone();
         result.rectifiedLeft = reconResult.rectifiedLeft.clone();
         result.rectifiedRight = reconResult.rectifiedRight.clone();
         result.pointCloud3D = reconResult.pointCloud3D.clone();
+        result.confidenceMap = reconResult.confidenceMap.clone();
+        result.normals = reconResult.normals.clone();
         result.colorImage = reconResult.rectifiedLeft.clone();
+        memoryTracker.mark("copy");
+        
+        // 保存文件: 各输出在写入线程池中并行编码和写入
+        fs::create_directories(params.outputFolder);
+        OutputWriter::Writer& writer = OutputWriter::sharedWriter();
+        OutputWriter::ArtifactFutures futures;
         
-        // 保存文件
         if (params.generateDepthMap) {
             std::string depthPath = params.outputFolder + "/depth_map.jpg";
-            StereoReconstruction::saveDepthMap(result.depthMap, depthPath);
-            std::cout << "深度图已保存: " << depthPath << std::endl;
+            cv::Mat depthMap = result.depthMap;
+            futures.push_back(writer.writeTask(depthPath, [depthMap, depthPath] {
+                return StereoReconstruction::saveDepthMap(depthMap, depthPath);
+            }));
         }
         
         if (params.generateRectifiedImages) {
-            StereoReconstruction::saveRectifiedImages(result.rectifiedLeft, result.rectifiedRight, 
-                                                     params.outputFolder);
-            std::cout << "矫正图已保存" << std::endl;
+            futures.push_back(writer.writeImage(params.outputFolder + "/rectified_left.jpg", result.rectifiedLeft));
+            futures.push_back(writer.writeImage(params.outputFolder + "/rectified_right.jpg", result.rectifiedRight));
         }
         
         if (params.generateResidualMap) {
-            std::string residualPath = params.outputFolder + "/residual_map.jpg";
-            cv::imwrite(residualPath, result.residualMap);
-            std::cout << "残差图已保存: " << residualPath << std::endl;
+            futures.push_back(writer.writeImage(params.outputFolder + "/residual_map.jpg", result.residualMap));
         }
         
         if (params.generatePointCloud) {
             result.pointCloudFile = params.outputFolder + "/point_cloud.ply";
-            StereoReconstruction::savePointCloud(result.pointCloud3D, result.colorImage, 
-                                                result.pointCloudFile, 0);
-            std::cout << "点云模型已保存: " << result.pointCloudFile << std::endl;
+            cv::Mat points = result.pointCloud3D, colors = result.colorImage, confidence = result.confidenceMap;
+            cv::Mat normals = result.normals;
+            std::string pointCloudFile = result.pointCloudFile;
+            float minConfidence = params.minConfidence;
+            futures.push_back(writer.writeTask(pointCloudFile,
+                [points, colors, confidence, normals, pointCloudFile, minConfidence] {
+                    return StereoReconstruction::savePointCloud(points, colors, pointCloudFile, 0,
+                                                               confidence, minConfidence, normals);
+                }));
+        }
+        
+        result.artifacts = OutputWriter::collect(futures);
+        for (const auto& artifact : result.artifacts) {
+            if (artifact.success) {
+                std::cout << "已保存: " << artifact.path << std::endl;
+            }
+        }
+        memoryTracker.mark("save");
+        
+        if (params.trackMemory) {
+            const auto& stages = memoryTracker.stages();
+            result.stageMemory.insert(result.stageMemory.end(), stages.begin(), stages.end());
+            MemoryProfile::saveStageMemory(result.stageMemory, params.outputFolder + "/memory_profile.json");
         }
         
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -138,21 +173,9 @@ bool generateComplete3DModel(const std::string& leftImage, const std::string& ri
     return result.success;
 }
 
-bool compareWithReferenceImage(const std::string& rectifiedImage, 
-                              const std::string& referenceImage) {
-    cv::Mat rectified = cv::imread(rectifiedImage);
-    cv::Mat reference = cv::imread(referenceImage);
-    
-    if (rectified.empty()) {
-        std::cerr << "无法读取矫正图: " << rectifiedImage << std::endl;
-        return false;
-    }
-    
-    if (reference.empty()) {
-        std::cout << "参考图像不存在: " << referenceImage << std::endl;
-        std::cout << "矫正图已生成，请手动对比质量" << std::endl;
-        return true;
-    }
+double referenceImageDifference(const cv::Mat& rectifiedImage, const cv::Mat& referenceImage) {
+    cv::Mat rectified = rectifiedImage;
+    cv::Mat reference = referenceImage;
     
     // 确保图像尺寸一致后再进行对比
     if (rectified.size() != reference.size()) {
@@ -172,20 +195,44 @@ bool compareWithReferenceImage(const std::string& rectifiedImage,
         // 简单的图像质量对比
         cv::Mat diff;
         cv::absdiff(rectified, reference, diff);
-        cv::Scalar meanDiff = cv::mean(diff);
-        
-        std::cout << "\n=== 矫正图质量对比 ===" << std::endl;
-        std::cout << "与效果图的平均差异: " << meanDiff[0] << std::endl;
-        
-        if (meanDiff[0] < 50) {
-            std::cout << "矫正图质量良好，与效果图相似" << std::endl;
-        } else {
-            std::cout << "矫正图与效果图存在较大差异，可能需要调整参数" << std::endl;
-        }
+        return cv::mean(diff)[0];
     } catch (const std::exception& e) {
         std::cout << "图像对比过程中出错，跳过对比: " << e.what() << std::endl;
     }
     
+    return -1.0;
+}
+
+bool compareWithReferenceImage(const std::string& rectifiedImage, 
+                              const std::string& referenceImage) {
+    cv::Mat rectified = cv::imread(rectifiedImage);
+    cv::Mat reference = cv::imread(referenceImage);
+    
+    if (rectified.empty()) {
+        std::cerr << "无法读取矫正图: " << rectifiedImage << std::endl;
+        return false;
+    }
+    
+    if (reference.empty()) {
+        std::cout << "参考图像不存在: " << referenceImage << std::endl;
+        std::cout << "矫正图已生成，请手动对比质量" << std::endl;
+        return true;
+    }
+    
+    double meanDiff = referenceImageDifference(rectified, reference);
+    if (meanDiff < 0) {
+        return true;
+    }
+    
+    std::cout << "\n=== 矫正图质量对比 ===" << std::endl;
+    std::cout << "与效果图的平均差异: " << meanDiff << std::endl;
+    
+    if (meanDiff < REFERENCE_DIFF_THRESHOLD) {
+        std::cout << "矫正图质量良好，与效果图相似" << std::endl;
+    } else {
+        std::cout << "矫正图与效果图存在较大差异，可能需要调整参数" << std::endl;
+    }
+    
     return true;
 }
 
@@ -214,6 +261,11 @@ void showProcessingStats(const ModelingResult& result) {
     }
     
     std::cout << "矫正图尺寸: " << result.rectifiedLeft.size() << std::endl;
+    
+    if (!result.stageMemory.empty()) {
+        std::cout << "\n各阶段内存使用:" << std::endl;
+        MemoryProfile::printStageMemory(result.stageMemory);
+    }
 }
 
 }
\ No newline at end of file
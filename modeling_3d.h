@@ -1,6 +1,9 @@
 #pragma once
+#include "output_writer.h"
+#include "memory_profile.h"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
 
 namespace Modeling3D {
     struct ModelingParams {
@@ -13,6 +16,10 @@ namespace Modeling3D {
         bool generateDepthMap;   // 是否生成深度图
         bool generateResidualMap;// 是否生成残差图
         bool generateRectifiedImages; // 是否生成矫正图
+        float minConfidence = 0.0f;   // 低于该匹配置信度的点不写入点云
+        bool trackMemory = false;     // 记录各阶段的内存分配与RSS, 并写入 memory_profile.json
+        bool removeOutliers = false;  // 导出前去除深度边缘的飞点和无效视差点
+        bool computeNormals = false;  // 计算法向量并写入点云 (nx ny nz)
     };
     
     struct ModelingResult {
@@ -21,8 +28,12 @@ namespace Modeling3D {
         cv::Mat rectifiedLeft;
         cv::Mat rectifiedRight;
         cv::Mat pointCloud3D;
+        cv::Mat confidenceMap;
+        cv::Mat normals;
         cv::Mat colorImage;
         std::string pointCloudFile;
+        std::vector<OutputWriter::ArtifactStatus> artifacts; // 每个输出文件的写入结果
+        std::vector<MemoryProfile::StageMemory> stageMemory; // 仅在 trackMemory 时记录
         bool success;
         double processingTime;
     };
@@ -37,6 +48,12 @@ namespace Modeling3D {
     bool generateComplete3DModel(const std::string& leftImage, const std::string& rightImage,
                                 const std::string& calibrationFile, const std::string& outputFolder);
     
+    // 矫正图与效果图的平均差异阈值
+    const double REFERENCE_DIFF_THRESHOLD = 50.0;
+    
+    // 矫正图与效果图的平均绝对差异（对比失败时返回负值）
+    double referenceImageDifference(const cv::Mat& rectifiedImage, const cv::Mat& referenceImage);
+    
     // 对比矫正图与效果图
     bool compareWithReferenceImage(const std::string& rectifiedImage, 
                                   const std::string& referenceImage);
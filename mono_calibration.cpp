@@ -1,8 +1,18 @@
 #include "mono_calibration.h"
+#include "corner_detection.h"
+#include "output_writer.h"
+#include "task_pool.h"
+#include "thread_config.h"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
 namespace fs = std::filesystem;
 
 namespace MonoCalibration {
@@ -20,6 +30,7 @@ CalibrationResult calibrateCameraFromPoints(const std::vector<std::vector<cv::Po
             result.rvecs, result.tvecs
         );
         
+        result.imageSize = imageSize;
         result.success = true;
         std::cout << "Monocular calibration RMS error: " << result.reprojectionError << std::endl;
         
@@ -40,6 +51,7 @@ bool saveCalibrationData(const CalibrationResult& result, const std::string& out
     fs << "Camera_Matrix" << result.cameraMatrix;
     fs << "Distortion_Coefficients" << result.distCoeffs;
     fs << "Reprojection_Error" << result.reprojectionError;
+    fs << "Image_Size" << result.imageSize;
     
     fs.release();
     return true;
@@ -55,21 +67,256 @@ bool loadCalibrationData(const std::string& inputFile, CalibrationResult& result
     fs["Camera_Matrix"] >> result.cameraMatrix;
     fs["Distortion_Coefficients"] >> result.distCoeffs;
     fs["Reprojection_Error"] >> result.reprojectionError;
+    result.imageSize = cv::Size();
+    if (!fs["Image_Size"].empty()) {
+        fs["Image_Size"] >> result.imageSize;
+    }
     
     result.success = true;
     fs.release();
     return true;
 }
 
+void computePerViewErrors(CalibrationResult& result,
+                          const std::vector<std::vector<cv::Point2f>>& imagePoints,
+                          const std::vector<std::vector<cv::Point3f>>& objectPoints) {
+    result.perViewErrors.assign(imagePoints.size(), 0.0);
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(imagePoints.size())), [&](const cv::Range& range) {
+        std::vector<cv::Point2f> projected;
+        for (int v = range.start; v < range.end; v++) {
+            cv::projectPoints(objectPoints[v], result.rvecs[v], result.tvecs[v],
+                              result.cameraMatrix, result.distCoeffs, projected);
+            
+            double error = cv::norm(imagePoints[v], projected, cv::NORM_L2);
+            result.perViewErrors[v] = std::sqrt(error * error / std::max<size_t>(1, projected.size()));
+        }
+    });
+}
+
+// Camera matrix for images of the given size; intrinsics scale with the pixel grid, so only a
+// uniformly scaled version of the calibration size can be undistorted
+static bool cameraMatrixForSize(const CalibrationResult& result, cv::Size size, cv::Mat& cameraMatrix) {
+    if (result.imageSize.area() <= 0 || size == result.imageSize) {
+        cameraMatrix = result.cameraMatrix;
+        return true;
+    }
+    
+    double sx = static_cast<double>(size.width) / result.imageSize.width;
+    double sy = static_cast<double>(size.height) / result.imageSize.height;
+    if (std::abs(sx - sy) > 0.01 * std::max(sx, sy)) {
+        return false;
+    }
+    
+    cameraMatrix = result.cameraMatrix.clone();
+    cameraMatrix.row(0) *= sx;
+    cameraMatrix.row(1) *= sy;
+    return true;
+}
+
+bool undistortImages(const CalibrationResult& result, const std::string& inputFolder,
+                     const std::string& outputFolder) {
+    try {
+        std::vector<fs::path> images;
+        for (const auto& entry : fs::directory_iterator(inputFolder)) {
+            if (entry.is_regular_file()) {
+                std::string ext = entry.path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                
+                if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
+                    images.push_back(entry.path());
+                }
+            }
+        }
+        std::sort(images.begin(), images.end());
+        
+        if (images.empty()) {
+            std::cerr << "No images to undistort in: " << inputFolder << std::endl;
+            return false;
+        }
+        
+        fs::create_directories(outputFolder);
+        
+        if (result.imageSize.area() <= 0) {
+            std::cout << "Calibration image size unknown, intrinsics are used at every image size" << std::endl;
+        }
+        
+        // All views share one camera; a map is built the first time an image size is seen
+        std::mutex mapsMutex;
+        std::map<std::pair<int, int>, std::pair<cv::Mat, cv::Mat>> maps;
+        auto mapsFor = [&](cv::Size size, cv::Mat& mapX, cv::Mat& mapY) {
+            std::lock_guard<std::mutex> lock(mapsMutex);
+            auto key = std::make_pair(size.width, size.height);
+            auto found = maps.find(key);
+            if (found == maps.end()) {
+                cv::Mat cameraMatrix;
+                if (!cameraMatrixForSize(result, size, cameraMatrix)) {
+                    return false;
+                }
+                cv::Mat x, y;
+                cv::initUndistortRectifyMap(cameraMatrix, result.distCoeffs, cv::Mat(),
+                                            cameraMatrix, size, CV_16SC2, x, y);
+                found = maps.emplace(key, std::make_pair(x, y)).first;
+            }
+            mapX = found->second.first;
+            mapY = found->second.second;
+            return true;
+        };
+        
+        // Remaps and encodes share the process-wide pool
+        Threading::TaskPool& pool = Threading::sharedPool();
+        Threading::InFlightLimit inFlight(2 * pool.threadCount());
+        
+        OutputWriter::Writer& writer = OutputWriter::sharedWriter();
+        std::mutex futuresMutex;
+        OutputWriter::ArtifactFutures futures;
+        std::atomic<int> failedCount(0);
+        Threading::TaskGroup workers(pool);
+        
+        for (const auto& image : images) {
+            inFlight.acquire();
+            
+            workers.post([&, image] {
+                cv::Mat undistorted;
+                try {
+                    cv::Mat source = cv::imread(image.string());
+                    cv::Mat mapX, mapY;
+                    if (source.empty()) {
+                        std::cerr << "Cannot read image: " << image << std::endl;
+                    } else if (mapsFor(source.size(), mapX, mapY)) {
+                        cv::remap(source, undistorted, mapX, mapY, cv::INTER_LINEAR);
+                    } else {
+                        std::cerr << "Image size " << source.size() << " is not a scaled calibration size "
+                                  << result.imageSize << ": " << image << std::endl;
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error undistorting " << image << ": " << e.what() << std::endl;
+                    undistorted.release();
+                }
+                
+                if (undistorted.empty()) {
+                    failedCount++;
+                    inFlight.release();
+                    return;
+                }
+                
+                std::string outputPath = outputFolder + "/undistorted_" + image.filename().string();
+                Threading::InFlightLimit* limit = &inFlight;
+                auto future = writer.writeTask(outputPath, [undistorted, outputPath, limit] {
+                    struct SlotRelease {
+                        Threading::InFlightLimit* limit;
+                        ~SlotRelease() { limit->release(); }
+                    } done{limit};
+                    return cv::imwrite(outputPath, undistorted);
+                });
+                
+                std::lock_guard<std::mutex> lock(futuresMutex);
+                futures.push_back(std::move(future));
+            });
+        }
+        
+        workers.wait();
+        std::vector<OutputWriter::ArtifactStatus> artifacts = OutputWriter::collect(futures);
+        
+        int writtenCount = 0;
+        for (const auto& artifact : artifacts) {
+            if (artifact.success) {
+                writtenCount++;
+            }
+        }
+        
+        std::cout << "Undistortion completed: " << writtenCount << "/" << images.size()
+                  << " images written to " << outputFolder << std::endl;
+        if (failedCount > 0) {
+            std::cerr << failedCount << " images could not be read or undistorted" << std::endl;
+        }
+        return writtenCount > 0;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error in image undistortion: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 bool calibrateCamera(const std::string& cornerDataFolder, const std::string& imageFolder,
                     const std::string& outputFolder, int boardWidth, int boardHeight,
                     float squareSize, int imageWidth, int imageHeight, 
                     bool showReprojection, const std::string& rectifiedOutputFolder) {
-    
-    std::cout << "Monocular calibration functionality - using stereo calibration results" << std::endl;
-    fs::create_directories(outputFolder);
-    
-    return true;
+    try {
+        fs::create_directories(outputFolder);
+        
+        std::string cornerFile = cornerDataFolder + "/corners.bin";
+        CornerDetection::CornerSet cornerSet;
+        bool reuseCorners = fs::exists(cornerFile) && CornerDetection::loadCornerSet(cornerFile, cornerSet);
+        
+        // A corner set from another board layout would not match the object points
+        if (reuseCorners && (cornerSet.boardWidth != boardWidth || cornerSet.boardHeight != boardHeight)) {
+            std::cout << "Stale corner data (" << cornerSet.boardWidth << "x" << cornerSet.boardHeight
+                      << " board), detecting " << boardWidth << "x" << boardHeight << " corners again" << std::endl;
+            reuseCorners = false;
+        }
+        
+        if (!reuseCorners) {
+            if (!CornerDetection::detectAndDrawCorners(imageFolder, cornerDataFolder, boardWidth, boardHeight)) {
+                std::cerr << "Corner detection failed for: " << imageFolder << std::endl;
+                return false;
+            }
+            if (!CornerDetection::loadCornerSet(cornerFile, cornerSet)) {
+                return false;
+            }
+        }
+        
+        if (cornerSet.imagePoints.size() < 3) {
+            std::cerr << "Not enough calibration views: " << cornerSet.imagePoints.size() << std::endl;
+            return false;
+        }
+        
+        std::vector<cv::Point3f> board = CornerDetection::createObjectPoints(boardWidth, boardHeight, squareSize);
+        std::vector<std::vector<cv::Point3f>> objectPoints(cornerSet.imagePoints.size(), board);
+        
+        // Corner coordinates are pixels of the detection size, so the intrinsics are estimated
+        // at that size; a different requested size would give a camera matrix for other pixels
+        cv::Size imageSize = cornerSet.imageSize;
+        if (imageWidth > 0 && imageHeight > 0 && cv::Size(imageWidth, imageHeight) != imageSize) {
+            std::cerr << "Requested image size " << cv::Size(imageWidth, imageHeight)
+                      << " differs from the corner detection size " << imageSize << std::endl;
+            return false;
+        }
+        
+        CalibrationResult result = calibrateCameraFromPoints(cornerSet.imagePoints, objectPoints, imageSize);
+        if (!result.success) {
+            return false;
+        }
+        
+        computePerViewErrors(result, cornerSet.imagePoints, objectPoints);
+        
+        if (!saveCalibrationData(result, outputFolder + "/mono_calibration.xml")) {
+            return false;
+        }
+        
+        std::ofstream errorFile(outputFolder + "/reprojection_errors.csv");
+        errorFile << "image_index,rms_error" << std::endl;
+        for (size_t v = 0; v < result.perViewErrors.size(); v++) {
+            errorFile << cornerSet.imageIndices[v] << "," << result.perViewErrors[v] << std::endl;
+        }
+        
+        if (showReprojection) {
+            for (size_t v = 0; v < result.perViewErrors.size(); v++) {
+                std::cout << "View " << cornerSet.imageIndices[v] << " reprojection error: "
+                          << result.perViewErrors[v] << " px" << std::endl;
+            }
+        }
+        
+        if (!rectifiedOutputFolder.empty()) {
+            return undistortImages(result, imageFolder, rectifiedOutputFolder);
+        }
+        
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error in monocular calibration: " << e.what() << std::endl;
+        return false;
+    }
 }
 
 }
\ No newline at end of file
@@ -10,9 +10,13 @@ namespace MonoCalibration {
         std::vector<cv::Mat> rvecs;
         std::vector<cv::Mat> tvecs;
         double reprojectionError;
+        cv::Size imageSize;  // size the intrinsics were estimated at; empty for older files
         bool success;
+        // RMS reprojection error of each view, in calibration order
+        std::vector<double> perViewErrors;
     };
     
+    // imageWidth/imageHeight, when given, must match the size the corners were detected at
     bool calibrateCamera(const std::string& cornerDataFolder, const std::string& imageFolder,
                         const std::string& outputFolder, int boardWidth, int boardHeight,
                         float squareSize, int imageWidth, int imageHeight, 
@@ -22,6 +26,17 @@ namespace MonoCalibration {
                                                const std::vector<std::vector<cv::Point3f>>& objectPoints,
                                                cv::Size imageSize);
     
+    // Fills result.perViewErrors; views are projected in parallel
+    void computePerViewErrors(CalibrationResult& result,
+                              const std::vector<std::vector<cv::Point2f>>& imagePoints,
+                              const std::vector<std::vector<cv::Point3f>>& objectPoints);
+    
+    // Decodes and remaps on Threading::sharedPool() while the shared output writer encodes.
+    // One map is built per image size, with the camera matrix scaled from result.imageSize;
+    // images whose aspect ratio differs from the calibration are skipped and reported
+    bool undistortImages(const CalibrationResult& result, const std::string& inputFolder,
+                         const std::string& outputFolder);
+    
     bool saveCalibrationData(const CalibrationResult& result, const std::string& outputFile);
     
     bool loadCalibrationData(const std::string& inputFile, CalibrationResult& result);
@@ -0,0 +1,104 @@
+#include "output_writer.h"
+#include "thread_config.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace OutputWriter {
+
+Writer::Writer(int threadCount) : ownedPool(new Threading::TaskPool(threadCount)), pool(*ownedPool) {
+}
+
+Writer::Writer(Threading::TaskPool& sharedPool) : pool(sharedPool) {
+}
+
+std::future<ArtifactStatus> Writer::writeTask(const std::string& path, std::function<bool()> task) {
+    auto promise = std::make_shared<std::promise<ArtifactStatus>>();
+    std::future<ArtifactStatus> future = promise->get_future();
+    
+    pool.post([promise, path, task] {
+        ArtifactStatus status;
+        status.path = path;
+        status.success = false;
+        try {
+            status.success = task();
+            if (!status.success) {
+                status.error = "write failed";
+            }
+        } catch (const std::exception& e) {
+            status.error = e.what();
+        }
+        promise->set_value(status);
+    });
+    
+    return future;
+}
+
+std::future<ArtifactStatus> Writer::writeImage(const std::string& path, const cv::Mat& image) {
+    return writeTask(path, [path, image] {
+        return !image.empty() && cv::imwrite(path, image);
+    });
+}
+
+void Writer::waitIdle() {
+    pool.waitIdle();
+}
+
+Writer& sharedWriter() {
+    static Writer writer(Threading::sharedPool());
+    return writer;
+}
+
+ArtifactFutures writeReconstructionOutputs(Writer& writer,
+                                           const StereoReconstruction::ReconstructionOutput& output,
+                                           const std::string& outputFolder, int outputFormat,
+                                           bool useColorTexture, float minConfidence) {
+    fs::create_directories(outputFolder);
+    ArtifactFutures futures;
+    
+    cv::Mat depthMap = output.depthMap;
+    std::string depthPath = outputFolder + "/depth_map.jpg";
+    futures.push_back(writer.writeTask(depthPath, [depthMap, depthPath] {
+        return StereoReconstruction::saveDepthMap(depthMap, depthPath);
+    }));
+    
+    // Cached results carry no rectified pair or residual map
+    if (!output.fromCache) {
+        futures.push_back(writer.writeImage(outputFolder + "/rectified_left.jpg", output.rectifiedLeft));
+        futures.push_back(writer.writeImage(outputFolder + "/rectified_right.jpg", output.rectifiedRight));
+        futures.push_back(writer.writeImage(outputFolder + "/residual_map.jpg", output.residualMap));
+    }
+    
+    cv::Mat points = output.pointCloud3D;
+    cv::Mat colors = !useColorTexture ? cv::Mat() : output.fromCache ? output.pointColors : output.rectifiedLeft;
+    cv::Mat confidence = output.confidenceMap;
+    cv::Mat normals = output.normals;
+    std::string pointCloudPath = outputFolder + "/point_cloud.ply";
+    futures.push_back(writer.writeTask(pointCloudPath,
+        [points, colors, confidence, normals, pointCloudPath, outputFormat, minConfidence] {
+            return StereoReconstruction::savePointCloud(points, colors, pointCloudPath, outputFormat,
+                                                       confidence, minConfidence, normals);
+        }));
+    
+    return futures;
+}
+
+std::vector<ArtifactStatus> collect(ArtifactFutures& futures) {
+    std::vector<ArtifactStatus> statuses;
+    statuses.reserve(futures.size());
+    for (auto& future : futures) {
+        ArtifactStatus status = future.get();
+        if (!status.success) {
+            std::cerr << "Failed to write " << status.path << ": " << status.error << std::endl;
+        }
+        statuses.push_back(status);
+    }
+    futures.clear();
+    return statuses;
+}
+
+}
\ No newline at end of file
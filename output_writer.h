@@ -0,0 +1,52 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include "task_pool.h"
+#include <opencv2/opencv.hpp>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OutputWriter {
+    struct ArtifactStatus {
+        std::string path;
+        bool success;
+        std::string error;
+    };
+    
+    using ArtifactFutures = std::vector<std::future<ArtifactStatus>>;
+    
+    // Encodes and writes artifacts on a worker pool. Matrices are shared, not copied, so
+    // callers must not overwrite them in place until the matching future is ready.
+    class Writer {
+    public:
+        explicit Writer(int threadCount);
+        
+        // Runs on an existing pool such as Threading::sharedPool()
+        explicit Writer(Threading::TaskPool& sharedPool);
+        
+        std::future<ArtifactStatus> writeImage(const std::string& path, const cv::Mat& image);
+        
+        // Any encoder that reports success; exceptions become the artifact's error text
+        std::future<ArtifactStatus> writeTask(const std::string& path, std::function<bool()> task);
+        
+        void waitIdle();
+        
+    private:
+        std::unique_ptr<Threading::TaskPool> ownedPool;
+        Threading::TaskPool& pool;
+    };
+    
+    // Process-wide writer on Threading::sharedPool(), sized by the threading configuration
+    Writer& sharedWriter();
+    
+    // Queues depth map, rectified pair, residual map and point cloud for one reconstruction
+    ArtifactFutures writeReconstructionOutputs(Writer& writer,
+                                               const StereoReconstruction::ReconstructionOutput& output,
+                                               const std::string& outputFolder, int outputFormat,
+                                               bool useColorTexture, float minConfidence);
+    
+    // Waits for every artifact; failures are reported on stderr and returned
+    std::vector<ArtifactStatus> collect(ArtifactFutures& futures);
+}
\ No newline at end of file
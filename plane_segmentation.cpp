@@ -0,0 +1,236 @@
+#include "plane_segmentation.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+
+namespace PlaneSegmentation {
+
+namespace {
+
+bool isFinitePoint(const cv::Vec3f& p) {
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+double pointDistance(const cv::Vec4d& plane, const cv::Vec3f& p) {
+    return plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+}
+
+bool planeFromPoints(const cv::Vec3f& a, const cv::Vec3f& b, const cv::Vec3f& c, cv::Vec4d& plane) {
+    cv::Vec3d normal = cv::Vec3d(b - a).cross(cv::Vec3d(c - a));
+    double length = cv::norm(normal);
+    if (length < 1e-9) {
+        return false;
+    }
+    normal /= length;
+    plane = cv::Vec4d(normal[0], normal[1], normal[2], -normal.dot(cv::Vec3d(a)));
+    return true;
+}
+
+// Running first and second moments for a least-squares plane fit
+struct Moments {
+    double count = 0.0;
+    cv::Vec3d sum = cv::Vec3d(0, 0, 0);
+    cv::Matx33d outer = cv::Matx33d::zeros();
+    
+    void add(const cv::Vec3f& p) {
+        cv::Vec3d q(p[0], p[1], p[2]);
+        count += 1.0;
+        sum += q;
+        outer += q * q.t();
+    }
+    
+    void merge(const Moments& other) {
+        count += other.count;
+        sum += other.sum;
+        outer += other.outer;
+    }
+    
+    // Normal = eigenvector of the smallest covariance eigenvalue
+    bool fit(cv::Vec4d& plane) const {
+        if (count < 3.0) {
+            return false;
+        }
+        cv::Vec3d mean = sum / count;
+        cv::Matx33d covariance = outer * (1.0 / count) - mean * mean.t();
+        cv::Mat eigenvalues, eigenvectors;
+        if (!cv::eigen(cv::Mat(covariance), eigenvalues, eigenvectors)) {
+            return false;
+        }
+        cv::Vec3d normal(eigenvectors.at<double>(2, 0), eigenvectors.at<double>(2, 1), eigenvectors.at<double>(2, 2));
+        plane = cv::Vec4d(normal[0], normal[1], normal[2], -normal.dot(mean));
+        return true;
+    }
+};
+
+} // namespace
+
+std::vector<Plane> extractPlanes(const cv::Mat& points3D, const PlaneParams& params, const cv::Mat& validMask) {
+    CV_Assert(points3D.type() == CV_32FC3);
+    CV_Assert(validMask.empty() || (validMask.type() == CV_8UC1 && validMask.size() == points3D.size()));
+    
+    std::vector<Plane> planes;
+    const int stride = std::max(params.sampleStride, 1);
+    const double threshold = params.distanceThreshold;
+    
+    // Pixels claimed by an earlier plane
+    cv::Mat assigned = cv::Mat::zeros(points3D.size(), CV_8UC1);
+    auto isCandidate = [&](int y, int x) {
+        return !assigned.at<uchar>(y, x) && (validMask.empty() || validMask.at<uchar>(y, x)) &&
+               isFinitePoint(points3D.at<cv::Vec3f>(y, x));
+    };
+    
+    cv::RNG rng(params.seed);
+    
+    for (int planeIndex = 0; planeIndex < params.maxPlanes; planeIndex++) {
+        // Subsampled pixel coordinates; the points themselves stay in the cloud
+        std::vector<cv::Point> samples;
+        for (int y = 0; y < points3D.rows; y += stride) {
+            for (int x = 0; x < points3D.cols; x += stride) {
+                if (isCandidate(y, x)) {
+                    samples.emplace_back(x, y);
+                }
+            }
+        }
+        if (samples.size() < 3) {
+            break;
+        }
+        
+        // Hypotheses are drawn up front so the parallel scoring stays deterministic
+        std::vector<cv::Vec4d> hypotheses;
+        for (int i = 0; i < params.hypotheses * 4 && static_cast<int>(hypotheses.size()) < params.hypotheses; i++) {
+            const cv::Point& a = samples[rng.uniform(0, static_cast<int>(samples.size()))];
+            const cv::Point& b = samples[rng.uniform(0, static_cast<int>(samples.size()))];
+            const cv::Point& c = samples[rng.uniform(0, static_cast<int>(samples.size()))];
+            cv::Vec4d plane;
+            if (planeFromPoints(points3D.at<cv::Vec3f>(a), points3D.at<cv::Vec3f>(b), points3D.at<cv::Vec3f>(c), plane)) {
+                hypotheses.push_back(plane);
+            }
+        }
+        if (hypotheses.empty()) {
+            break;
+        }
+        
+        std::vector<int> scores(hypotheses.size(), 0);
+        cv::parallel_for_(cv::Range(0, static_cast<int>(hypotheses.size())), [&](const cv::Range& range) {
+            for (int h = range.start; h < range.end; h++) {
+                int inliers = 0;
+                for (const auto& sample : samples) {
+                    inliers += std::abs(pointDistance(hypotheses[h], points3D.at<cv::Vec3f>(sample))) <= threshold;
+                }
+                scores[h] = inliers;
+            }
+        });
+        
+        size_t best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+        cv::Vec4d plane = hypotheses[best];
+        
+        // Full-resolution refit on the inliers of the winning hypothesis
+        std::mutex momentsMutex;
+        Moments moments;
+        cv::parallel_for_(cv::Range(0, points3D.rows), [&](const cv::Range& range) {
+            Moments local;
+            for (int y = range.start; y < range.end; y++) {
+                const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+                for (int x = 0; x < points3D.cols; x++) {
+                    if (isCandidate(y, x) && std::abs(pointDistance(plane, p[x])) <= threshold) {
+                        local.add(p[x]);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(momentsMutex);
+            moments.merge(local);
+        });
+        moments.fit(plane);
+        
+        // Final inlier mask against the refined plane
+        Plane result;
+        result.coefficients = plane;
+        result.inlierMask = cv::Mat::zeros(points3D.size(), CV_8UC1);
+        std::atomic<int> inlierCount(0);
+        std::mutex residualMutex;
+        double squaredDistance = 0.0;
+        
+        cv::parallel_for_(cv::Range(0, points3D.rows), [&](const cv::Range& range) {
+            int localCount = 0;
+            double localSquares = 0.0;
+            for (int y = range.start; y < range.end; y++) {
+                const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+                uchar* mask = result.inlierMask.ptr<uchar>(y);
+                for (int x = 0; x < points3D.cols; x++) {
+                    if (!isCandidate(y, x)) {
+                        continue;
+                    }
+                    double distance = pointDistance(plane, p[x]);
+                    if (std::abs(distance) <= threshold) {
+                        mask[x] = 255;
+                        localCount++;
+                        localSquares += distance * distance;
+                    }
+                }
+            }
+            inlierCount += localCount;
+            std::lock_guard<std::mutex> lock(residualMutex);
+            squaredDistance += localSquares;
+        });
+        
+        result.inlierCount = inlierCount;
+        if (result.inlierCount < params.minInliers) {
+            break;
+        }
+        result.rmsDistance = std::sqrt(squaredDistance / result.inlierCount);
+        
+        assigned.setTo(255, result.inlierMask);
+        planes.push_back(result);
+    }
+    
+    return planes;
+}
+
+double measureSquareSize(const cv::Mat& points3D, const Plane& plane,
+                         const std::vector<cv::Point2f>& corners, cv::Size boardSize) {
+    if (static_cast<int>(corners.size()) != boardSize.area()) {
+        return 0.0;
+    }
+    
+    const cv::Vec3d normal(plane.coefficients[0], plane.coefficients[1], plane.coefficients[2]);
+    
+    // Corner pixels looked up in the cloud and snapped onto the plane
+    std::vector<cv::Vec3d> projected(corners.size());
+    std::vector<bool> valid(corners.size(), false);
+    for (size_t i = 0; i < corners.size(); i++) {
+        cv::Point pixel(cvRound(corners[i].x), cvRound(corners[i].y));
+        if (pixel.x < 0 || pixel.y < 0 || pixel.x >= points3D.cols || pixel.y >= points3D.rows) {
+            continue;
+        }
+        const cv::Vec3f& p = points3D.at<cv::Vec3f>(pixel);
+        if (!isFinitePoint(p)) {
+            continue;
+        }
+        projected[i] = cv::Vec3d(p) - normal * pointDistance(plane.coefficients, p);
+        valid[i] = true;
+    }
+    
+    double total = 0.0;
+    int pairs = 0;
+    for (int row = 0; row < boardSize.height; row++) {
+        for (int col = 0; col < boardSize.width; col++) {
+            int i = row * boardSize.width + col;
+            if (!valid[i]) {
+                continue;
+            }
+            if (col + 1 < boardSize.width && valid[i + 1]) {
+                total += cv::norm(projected[i + 1] - projected[i]);
+                pairs++;
+            }
+            if (row + 1 < boardSize.height && valid[i + boardSize.width]) {
+                total += cv::norm(projected[i + boardSize.width] - projected[i]);
+                pairs++;
+            }
+        }
+    }
+    return pairs > 0 ? total / pairs : 0.0;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace PlaneSegmentation {
+    struct PlaneParams {
+        float distanceThreshold = 2.0f; // inlier distance in calibration units (mm)
+        int sampleStride = 8;           // hypotheses are scored on every stride-th pixel per axis
+        int hypotheses = 512;
+        int maxPlanes = 3;
+        int minInliers = 5000;          // full-resolution inliers needed to accept a plane
+        unsigned int seed = 12345;      // fixed so repeated runs give the same planes
+    };
+    
+    struct Plane {
+        cv::Vec4d coefficients; // (nx, ny, nz, d) with n . p + d = 0 and |n| = 1
+        int inlierCount;
+        double rmsDistance;
+        cv::Mat inlierMask;     // CV_8U, same size as the cloud
+    };
+    
+    // Dominant planes of an organized CV_32FC3 cloud, largest first. Hypotheses from random
+    // point triples are scored in parallel on a subsampled pixel grid; the best one is refit
+    // and classified at full resolution. The cloud is read in place, never copied; each
+    // plane's inliers are excluded from the following searches. validMask (CV_8U) optionally
+    // restricts the search, e.g. to positive disparities.
+    std::vector<Plane> extractPlanes(const cv::Mat& points3D, const PlaneParams& params = PlaneParams(),
+                                     const cv::Mat& validMask = cv::Mat());
+    
+    // Mean spacing of adjacent board corners after projecting their 3D points onto the plane,
+    // for checking metric scale against the printed square size (8.2 mm for the project board)
+    double measureSquareSize(const cv::Mat& points3D, const Plane& plane,
+                             const std::vector<cv::Point2f>& corners, cv::Size boardSize);
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "point_cloud_filter.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace PointCloudFilter {
+
+int removeStatisticalOutliers(cv::Mat& points3D, const OutlierParams& params, const cv::Mat& disparity) {
+    CV_Assert(points3D.type() == CV_32FC3);
+    CV_Assert(disparity.empty() || (disparity.type() == CV_32FC1 && disparity.size() == points3D.size()));
+    
+    const int rows = points3D.rows;
+    const int cols = points3D.cols;
+    const int radius = std::max(params.radius, 1);
+    const float tooFew = -1.0f;
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    
+    auto isValid = [&](int y, int x) {
+        const cv::Vec3f& p = points3D.at<cv::Vec3f>(y, x);
+        if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2])) {
+            return false;
+        }
+        return disparity.empty() || disparity.at<float>(y, x) > 0.0f;
+    };
+    
+    // Pass 1: mean distance to the valid grid neighbors of every valid point, relative to its depth
+    cv::Mat meanDistance(points3D.size(), CV_32FC1);
+    std::mutex statsMutex;
+    double sum = 0.0, sumSquares = 0.0;
+    long long count = 0;
+    
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        double localSum = 0.0, localSquares = 0.0;
+        long long localCount = 0;
+        
+        for (int y = range.start; y < range.end; y++) {
+            float* out = meanDistance.ptr<float>(y);
+            int y0 = std::max(y - radius, 0), y1 = std::min(y + radius, rows - 1);
+            
+            for (int x = 0; x < cols; x++) {
+                if (!isValid(y, x)) {
+                    out[x] = invalid;
+                    continue;
+                }
+                
+                const cv::Vec3f& p = points3D.at<cv::Vec3f>(y, x);
+                int x0 = std::max(x - radius, 0), x1 = std::min(x + radius, cols - 1);
+                double distance = 0.0;
+                int neighbors = 0;
+                
+                for (int ny = y0; ny <= y1; ny++) {
+                    for (int nx = x0; nx <= x1; nx++) {
+                        if ((ny == y && nx == x) || !isValid(ny, nx)) {
+                            continue;
+                        }
+                        distance += cv::norm(points3D.at<cv::Vec3f>(ny, nx) - p);
+                        neighbors++;
+                    }
+                }
+                
+                if (neighbors < params.minNeighbors) {
+                    out[x] = tooFew;
+                    continue;
+                }
+                
+                double depth = std::max(static_cast<double>(std::abs(p[2])), 1e-6);
+                out[x] = static_cast<float>(distance / neighbors / depth);
+                localSum += out[x];
+                localSquares += static_cast<double>(out[x]) * out[x];
+                localCount++;
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(statsMutex);
+        sum += localSum;
+        sumSquares += localSquares;
+        count += localCount;
+    });
+    
+    double threshold = std::numeric_limits<double>::max();
+    if (count > 0) {
+        double mean = sum / count;
+        double stddev = std::sqrt(std::max(sumSquares / count - mean * mean, 0.0));
+        threshold = mean + params.stdRatio * stddev;
+    }
+    
+    // Pass 2: drop points far from their neighborhood, isolated and invalid points
+    std::atomic<int> removed(0);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        int localRemoved = 0;
+        for (int y = range.start; y < range.end; y++) {
+            const float* distance = meanDistance.ptr<float>(y);
+            cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            
+            for (int x = 0; x < cols; x++) {
+                bool wasFinite = std::isfinite(p[x][0]) && std::isfinite(p[x][1]) && std::isfinite(p[x][2]);
+                bool keep = std::isfinite(distance[x]) && distance[x] != tooFew && distance[x] <= threshold;
+                if (!keep) {
+                    p[x] = cv::Vec3f(invalid, invalid, invalid);
+                    localRemoved += wasFinite ? 1 : 0;
+                }
+            }
+        }
+        removed += localRemoved;
+    });
+    
+    return removed;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+
+namespace PointCloudFilter {
+    struct OutlierParams {
+        int radius = 2;          // image-space neighborhood of (2 * radius + 1)^2 pixels
+        int minNeighbors = 4;    // valid neighbors needed to keep a point
+        float stdRatio = 2.5f;   // keep points whose relative neighbor distance <= mean + stdRatio * stddev
+    };
+    
+    // Statistical outlier removal on an organized CV_32FC3 cloud (reprojectImageTo3D output).
+    // Neighbors come from the pixel grid, so no KD-tree is built; both passes run row-parallel.
+    // A pixel's footprint grows with depth, so each point's mean neighbor distance is divided
+    // by its depth before the statistics; otherwise far surfaces would be removed as outliers.
+    // Removed points, and points whose disparity is not positive when a disparity map is
+    // given, are set to NaN in place so savePointCloud skips them. Returns the number removed.
+    int removeStatisticalOutliers(cv::Mat& points3D, const OutlierParams& params = OutlierParams(),
+                                  const cv::Mat& disparity = cv::Mat());
+}
\ No newline at end of file
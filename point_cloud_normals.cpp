@@ -0,0 +1,263 @@
+#include "point_cloud_normals.h"
+#include <opencv2/opencv.hpp>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace PointCloudNormals {
+
+namespace {
+
+bool isFinitePoint(const cv::Vec3f& p) {
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+// Eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix (closed form)
+cv::Vec3d smallestEigenvector(double a00, double a01, double a02, double a11, double a12, double a22) {
+    // Eigenvalues from the trigonometric solution of the characteristic cubic
+    double q = (a00 + a11 + a22) / 3.0;
+    double p1 = a01 * a01 + a02 * a02 + a12 * a12;
+    double p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2.0 * p1;
+    double p = std::sqrt(p2 / 6.0);
+    if (p < 1e-12) {
+        return cv::Vec3d(0.0, 0.0, 0.0);
+    }
+    
+    double b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p;
+    double b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+    double r = (b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02)) / 2.0;
+    double phi = std::acos(std::min(std::max(r, -1.0), 1.0)) / 3.0;
+    double lambda = q + 2.0 * p * std::cos(phi + 2.0 * CV_PI / 3.0);
+    
+    // The eigenvector is orthogonal to the rows of A - lambda * I: take the best-conditioned cross product
+    cv::Vec3d row0(a00 - lambda, a01, a02);
+    cv::Vec3d row1(a01, a11 - lambda, a12);
+    cv::Vec3d row2(a02, a12, a22 - lambda);
+    cv::Vec3d c01 = row0.cross(row1), c02 = row0.cross(row2), c12 = row1.cross(row2);
+    double n01 = c01.dot(c01), n02 = c02.dot(c02), n12 = c12.dot(c12);
+    
+    cv::Vec3d best = c01;
+    double bestNorm = n01;
+    if (n02 > bestNorm) {
+        best = c02;
+        bestNorm = n02;
+    }
+    if (n12 > bestNorm) {
+        best = c12;
+        bestNorm = n12;
+    }
+    if (bestNorm <= 0.0) {
+        return cv::Vec3d(0.0, 0.0, 0.0);
+    }
+    return best / std::sqrt(bestNorm);
+}
+
+bool isDepthJump(float z, float neighborZ, float maxDepthJump) {
+    return std::abs(neighborZ - z) > maxDepthJump * std::abs(z);
+}
+
+// Normal from the window around (x, y) using only neighbors on the center's surface
+cv::Vec3d directNormal(const cv::Mat& points3D, const cv::Mat& valid, int x, int y, int radius,
+                       float maxDepthJump) {
+    const cv::Vec3f& center = points3D.at<cv::Vec3f>(y, x);
+    int y0 = std::max(y - radius, 0), y1 = std::min(y + radius, points3D.rows - 1);
+    int x0 = std::max(x - radius, 0), x1 = std::min(x + radius, points3D.cols - 1);
+    
+    // Moments about the center point
+    double n = 0.0;
+    cv::Vec3d s(0.0, 0.0, 0.0), sd(0.0, 0.0, 0.0), sc(0.0, 0.0, 0.0);
+    for (int ny = y0; ny <= y1; ny++) {
+        const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(ny);
+        const uchar* v = valid.ptr<uchar>(ny);
+        for (int nx = x0; nx <= x1; nx++) {
+            if (!v[nx] || isDepthJump(center[2], p[nx][2], maxDepthJump)) {
+                continue;
+            }
+            double px = p[nx][0] - center[0], py = p[nx][1] - center[1], pz = p[nx][2] - center[2];
+            s += cv::Vec3d(px, py, pz);
+            sd += cv::Vec3d(px * px, py * py, pz * pz);
+            sc += cv::Vec3d(px * py, px * pz, py * pz);
+            n += 1.0;
+        }
+    }
+    if (n < 3.0) {
+        return cv::Vec3d(0.0, 0.0, 0.0);
+    }
+    
+    cv::Vec3d mean = s / n;
+    return smallestEigenvector(sd[0] / n - mean[0] * mean[0], sc[0] / n - mean[0] * mean[1],
+                               sc[1] / n - mean[0] * mean[2], sd[1] / n - mean[1] * mean[1],
+                               sc[2] / n - mean[1] * mean[2], sd[2] / n - mean[2] * mean[2]);
+}
+
+} // namespace
+
+void computeNormals(const cv::Mat& points3D, cv::Mat& normals, int radius,
+                    const cv::Mat& validMask, float maxDepthJump) {
+    CV_Assert(points3D.type() == CV_32FC3 && radius >= 1);
+    CV_Assert(validMask.empty() || (validMask.type() == CV_8UC1 && validMask.size() == points3D.size()));
+    
+    const int rows = points3D.rows;
+    const int cols = points3D.cols;
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    
+    // Points that take part in any window: finite and, with a mask, matched
+    cv::Mat valid(points3D.size(), CV_8UC1);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            const uchar* m = validMask.empty() ? nullptr : validMask.ptr<uchar>(y);
+            uchar* v = valid.ptr<uchar>(y);
+            for (int x = 0; x < cols; x++) {
+                v[x] = (isFinitePoint(p[x]) && (!m || m[x])) ? 1 : 0;
+            }
+        }
+    });
+    
+    // Valid points next to a hole or to a neighbor on another surface. A window holding points
+    // of two surfaces always holds one of these (on any 4-connected path between them inside
+    // the window), so windows without them use the integral images and the rest are evaluated
+    // directly.
+    cv::Mat boundary(points3D.size(), CV_64FC1);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        const int dx[] = {-1, 1, 0, 0}, dy[] = {0, 0, -1, 1};
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            const uchar* v = valid.ptr<uchar>(y);
+            double* b = boundary.ptr<double>(y);
+            for (int x = 0; x < cols; x++) {
+                bool edge = false;
+                for (int k = 0; k < 4 && v[x] && !edge; k++) {
+                    int nx = x + dx[k], ny = y + dy[k];
+                    if (nx < 0 || nx >= cols || ny < 0 || ny >= rows) {
+                        continue;
+                    }
+                    edge = !valid.at<uchar>(ny, nx) ||
+                           isDepthJump(p[x][2], points3D.at<cv::Vec3f>(ny, nx)[2], maxDepthJump);
+                }
+                b[x] = edge ? 1.0 : 0.0;
+            }
+        }
+    });
+    
+    // Moments are taken about the cloud centroid so the window covariances do not lose
+    // precision to large absolute coordinates
+    cv::Vec3d centroid(0.0, 0.0, 0.0);
+    long long validCount = 0;
+    std::mutex centroidMutex;
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        cv::Vec3d localSum(0.0, 0.0, 0.0);
+        long long localCount = 0;
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            const uchar* v = valid.ptr<uchar>(y);
+            for (int x = 0; x < cols; x++) {
+                if (v[x]) {
+                    localSum += cv::Vec3d(p[x][0], p[x][1], p[x][2]);
+                    localCount++;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(centroidMutex);
+        centroid += localSum;
+        validCount += localCount;
+    });
+    
+    normals.create(points3D.size(), CV_32FC3);
+    if (validCount == 0) {
+        normals.setTo(cv::Scalar::all(invalid));
+        return;
+    }
+    centroid /= static_cast<double>(validCount);
+    
+    // First moments (x, y, z), second moments (xx, yy, zz), (xy, xz, yz) and the valid count
+    cv::Mat first(points3D.size(), CV_64FC3), diagonal(points3D.size(), CV_64FC3);
+    cv::Mat cross(points3D.size(), CV_64FC3), count(points3D.size(), CV_64FC1);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            cv::Vec3d* f = first.ptr<cv::Vec3d>(y);
+            cv::Vec3d* d = diagonal.ptr<cv::Vec3d>(y);
+            cv::Vec3d* c = cross.ptr<cv::Vec3d>(y);
+            double* n = count.ptr<double>(y);
+            const uchar* v = valid.ptr<uchar>(y);
+            for (int x = 0; x < cols; x++) {
+                if (!v[x]) {
+                    f[x] = d[x] = c[x] = cv::Vec3d(0.0, 0.0, 0.0);
+                    n[x] = 0.0;
+                    continue;
+                }
+                double px = p[x][0] - centroid[0], py = p[x][1] - centroid[1], pz = p[x][2] - centroid[2];
+                f[x] = cv::Vec3d(px, py, pz);
+                d[x] = cv::Vec3d(px * px, py * py, pz * pz);
+                c[x] = cv::Vec3d(px * py, px * pz, py * pz);
+                n[x] = 1.0;
+            }
+        }
+    });
+    
+    cv::Mat firstSum, diagonalSum, crossSum, countSum, boundarySum;
+    cv::integral(first, firstSum, CV_64F);
+    cv::integral(diagonal, diagonalSum, CV_64F);
+    cv::integral(cross, crossSum, CV_64F);
+    cv::integral(count, countSum, CV_64F);
+    cv::integral(boundary, boundarySum, CV_64F);
+    
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            const uchar* v = valid.ptr<uchar>(y);
+            cv::Vec3f* out = normals.ptr<cv::Vec3f>(y);
+            int y0 = std::max(y - radius, 0), y1 = std::min(y + radius, rows - 1) + 1;
+            
+            for (int x = 0; x < cols; x++) {
+                out[x] = cv::Vec3f(invalid, invalid, invalid);
+                if (!v[x]) {
+                    continue;
+                }
+                int x0 = std::max(x - radius, 0), x1 = std::min(x + radius, cols - 1) + 1;
+                
+                double n = countSum.at<double>(y1, x1) - countSum.at<double>(y0, x1)
+                         - countSum.at<double>(y1, x0) + countSum.at<double>(y0, x0);
+                if (n < 3.0) {
+                    continue;
+                }
+                
+                double edges = boundarySum.at<double>(y1, x1) - boundarySum.at<double>(y0, x1)
+                             - boundarySum.at<double>(y1, x0) + boundarySum.at<double>(y0, x0);
+                
+                cv::Vec3d normal;
+                if (edges > 0.0) {
+                    normal = directNormal(points3D, valid, x, y, radius, maxDepthJump);
+                } else {
+                    cv::Vec3d s = firstSum.at<cv::Vec3d>(y1, x1) - firstSum.at<cv::Vec3d>(y0, x1)
+                                - firstSum.at<cv::Vec3d>(y1, x0) + firstSum.at<cv::Vec3d>(y0, x0);
+                    cv::Vec3d sd = diagonalSum.at<cv::Vec3d>(y1, x1) - diagonalSum.at<cv::Vec3d>(y0, x1)
+                                 - diagonalSum.at<cv::Vec3d>(y1, x0) + diagonalSum.at<cv::Vec3d>(y0, x0);
+                    cv::Vec3d sc = crossSum.at<cv::Vec3d>(y1, x1) - crossSum.at<cv::Vec3d>(y0, x1)
+                                 - crossSum.at<cv::Vec3d>(y1, x0) + crossSum.at<cv::Vec3d>(y0, x0);
+                    
+                    cv::Vec3d mean = s / n;
+                    normal = smallestEigenvector(sd[0] / n - mean[0] * mean[0],
+                                                 sc[0] / n - mean[0] * mean[1],
+                                                 sc[1] / n - mean[0] * mean[2],
+                                                 sd[1] / n - mean[1] * mean[1],
+                                                 sc[2] / n - mean[1] * mean[2],
+                                                 sd[2] / n - mean[2] * mean[2]);
+                }
+                if (normal.dot(normal) == 0.0) {
+                    continue;
+                }
+                
+                // Orient toward the camera at the origin
+                if (normal.dot(cv::Vec3d(p[x][0], p[x][1], p[x][2])) > 0.0) {
+                    normal = -normal;
+                }
+                out[x] = cv::Vec3f(static_cast<float>(normal[0]), static_cast<float>(normal[1]),
+                                   static_cast<float>(normal[2]));
+            }
+        }
+    });
+}
+
+}
\ No newline at end of file
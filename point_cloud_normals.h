@@ -0,0 +1,15 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+
+namespace PointCloudNormals {
+    // Per-point normals of an organized CV_32FC3 cloud from integral images of the XYZ
+    // moments: each pixel's (2 * radius + 1)^2 window covariance costs the same regardless
+    // of radius, and its smallest eigenvector is the normal. Normals face the camera.
+    // validMask (CV_8U, e.g. disparity > 0) excludes pixels whose points are finite but
+    // unmatched. Windows crossing a depth discontinuity are evaluated directly and keep only
+    // neighbors within maxDepthJump (relative to the center depth) so that foreground and
+    // background do not mix.
+    // Output is CV_32FC3, NaN where the point is invalid or has fewer than 3 valid neighbors.
+    void computeNormals(const cv::Mat& points3D, cv::Mat& normals, int radius = 3,
+                        const cv::Mat& validMask = cv::Mat(), float maxDepthJump = 0.05f);
+}
\ No newline at end of file
@@ -0,0 +1,293 @@
+// regression_suite.cpp - 基于金标准输出的精度与性能回归测试
+// 用法: regression_suite <项目根目录> [--update] [--timing]
+// 对 picture/build_pic 中的每一对图像进行重建, 将视差、有效点比例、矫正图以及各阶段耗时
+// 与 golden/build_pic_golden.yml 中保存的基准对比, 任何一项超出容差则返回非零
+// 各阶段耗时以同一次运行中固定校准负载的耗时为单位保存, 不依赖生成基准的机器;
+// 耗时超限默认只打印, --timing 时计为失败
+// --update 重新生成基准文件 (仅在确认精度与性能变化可接受后使用)
+#include "stereo_reconstruction.h"
+#include "modeling_3d.h"
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// 对比用的缩略图比例 (1/8 分辨率, 足以反映视差与矫正的整体变化)
+const double THUMBNAIL_SCALE = 0.125;
+
+// 容差
+const double MAX_DISPARITY_DIFF = 1.0;      // 共同有效像素的平均视差差异 (像素)
+const double MAX_VALID_RATIO_DIFF = 0.02;   // 有效点比例的绝对变化
+const double MAX_RECTIFIED_DIFF = 2.0;      // 矫正缩略图的平均灰度差异
+const double MAX_TIMING_RATIO = 1.5;        // 各阶段耗时相对基准的最大倍数
+const double TIMING_SLACK_MS = 20.0;        // 短阶段的计时抖动余量
+const int CALIBRATION_RUNS = 5;             // 校准负载的计时次数 (取中位数)
+
+struct PairResult {
+    std::string name;
+    cv::Mat disparityThumb;
+    cv::Mat rectifiedThumb;
+    double validRatio;
+};
+
+static cv::Mat makeThumbnail(const cv::Mat& image, int interpolation) {
+    cv::Mat thumb;
+    cv::resize(image, thumb, cv::Size(), THUMBNAIL_SCALE, THUMBNAIL_SCALE, interpolation);
+    return thumb;
+}
+
+static double validRatio(const cv::Mat& disparity) {
+    if (disparity.empty()) {
+        return 0.0;
+    }
+    return static_cast<double>(cv::countNonZero(disparity > 0)) / disparity.total();
+}
+
+// 仅在两者都有效的像素上比较视差, 有效区域的变化由有效点比例单独检查
+static double disparityDifference(const cv::Mat& current, const cv::Mat& golden) {
+    if (current.size() != golden.size()) {
+        return -1.0;
+    }
+    cv::Mat mask = (current > 0) & (golden > 0);
+    if (cv::countNonZero(mask) == 0) {
+        return 0.0;
+    }
+    cv::Mat diff;
+    cv::absdiff(current, golden, diff);
+    return cv::mean(diff, mask)[0];
+}
+
+static double rectifiedDifference(const cv::Mat& current, const cv::Mat& golden) {
+    if (current.size() != golden.size() || current.type() != golden.type()) {
+        return -1.0;
+    }
+    cv::Mat diff;
+    cv::absdiff(current, golden, diff);
+    return cv::mean(diff)[0];
+}
+
+// 校准负载: 固定随机纹理对上的 SGBM 匹配, 先预热一次, 取多次计时的中位数
+static double calibrationMilliseconds() {
+    cv::Mat left(480, 640, CV_8UC1), right;
+    cv::RNG rng(12345);
+    rng.fill(left, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(left, left, cv::Size(3, 3), 0);
+    cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, -8, 0, 1, 0);
+    cv::warpAffine(left, right, shift, left.size());
+    
+    cv::Ptr<cv::StereoSGBM> matcher = cv::StereoSGBM::create(0, 64, 5);
+    cv::Mat disparity;
+    matcher->compute(left, right, disparity);
+    
+    std::vector<double> times;
+    for (int run = 0; run < CALIBRATION_RUNS; run++) {
+        int64 start = cv::getTickCount();
+        matcher->compute(left, right, disparity);
+        times.push_back((cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return std::max(times[times.size() / 2], 1e-3);
+}
+
+static bool saveGolden(const std::string& goldenFile, const std::vector<PairResult>& results,
+                       const std::map<std::string, double>& stageTotals, double calibrationMs) {
+    cv::FileStorage fs(goldenFile, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        std::cerr << "无法写入基准文件: " << goldenFile << std::endl;
+        return false;
+    }
+    
+    fs << "pairs" << "[";
+    for (const auto& result : results) {
+        fs << "{" << "name" << result.name
+           << "validRatio" << result.validRatio
+           << "disparity" << result.disparityThumb
+           << "rectified" << result.rectifiedThumb << "}";
+    }
+    fs << "]";
+    
+    // 耗时以校准负载为单位, calibrationMs 仅作记录
+    fs << "calibrationMs" << calibrationMs;
+    fs << "relativeTimings" << "{";
+    for (const auto& stage : stageTotals) {
+        fs << stage.first << stage.second / calibrationMs;
+    }
+    fs << "}";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "用法: " << argv[0] << " <项目根目录> [--update] [--timing]" << std::endl;
+        return -1;
+    }
+    
+    std::string rootFolder = argv[1];
+    bool update = false, enforceTiming = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--update") {
+            update = true;
+        } else if (arg == "--timing") {
+            enforceTiming = true;
+        }
+    }
+    
+    std::string pairFolder = rootFolder + "/picture/build_pic";
+    std::string calibrationFile = rootFolder + "/MyProject/Calibration_Data/stereo_calibration.xml";
+    std::string referenceImage = rootFolder + "/效果图.jpg";
+    std::string goldenFile = rootFolder + "/golden/build_pic_golden.yml";
+    
+    std::vector<std::string> names;
+    for (const auto& entry : fs::directory_iterator(pairFolder + "/left")) {
+        std::string name = entry.path().filename().string();
+        if (fs::exists(pairFolder + "/right/" + name)) {
+            names.push_back(name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+    
+    if (names.empty()) {
+        std::cerr << "未找到测试图像对: " << pairFolder << std::endl;
+        return -1;
+    }
+    
+    std::cout << "=== 回归测试: " << names.size() << " 对图像 ===" << std::endl;
+    
+    double calibrationMs = calibrationMilliseconds();
+    std::cout << "校准负载耗时: " << calibrationMs << " ms" << std::endl;
+    
+    int failures = 0;
+    std::vector<PairResult> results;
+    std::map<std::string, double> stageTotals;
+    
+    for (const auto& name : names) {
+        StereoReconstruction::ReconstructionParams params;
+        params.leftImagePath = pairFolder + "/left/" + name;
+        params.rightImagePath = pairFolder + "/right/" + name;
+        params.calibrationFile = calibrationFile;
+        params.outputFormat = 0;
+        params.meshGeneration = 0;
+        params.quality = 3;
+        params.useColorTexture = false;
+        params.maxDepth = 10000.0f;
+        params.minDepth = 0.0f;
+        params.algorithm = 1;
+        params.postProcessing = 0;
+        
+        StereoReconstruction::ReconstructionOutput output =
+            StereoReconstruction::performStereoReconstruction(params);
+        if (!output.success) {
+            std::cerr << "[失败] " << name << ": 重建失败" << std::endl;
+            failures++;
+            continue;
+        }
+        
+        PairResult result;
+        result.name = name;
+        result.validRatio = validRatio(output.depthMap);
+        result.disparityThumb = makeThumbnail(output.depthMap, cv::INTER_NEAREST);
+        result.rectifiedThumb = makeThumbnail(output.rectifiedLeft, cv::INTER_AREA);
+        results.push_back(result);
+        
+        for (const auto& timing : output.stageTimings) {
+            stageTotals[timing.stage] += timing.milliseconds;
+        }
+        
+        // 第一对图像的矫正图与效果图对比, 仅供参考, 不计入失败 (精度以基准文件为准)
+        if (name == "1.jpg") {
+            cv::Mat reference = cv::imread(referenceImage, cv::IMREAD_GRAYSCALE);
+            if (!reference.empty()) {
+                double referenceDiff = Modeling3D::referenceImageDifference(output.rectifiedLeft, reference);
+                if (referenceDiff >= 0) {
+                    std::cout << "与效果图的平均差异: " << referenceDiff;
+                    if (referenceDiff >= Modeling3D::REFERENCE_DIFF_THRESHOLD) {
+                        std::cout << " (差异较大, 请手动检查矫正图)";
+                    }
+                    std::cout << std::endl;
+                }
+            }
+        }
+    }
+    
+    if (update) {
+        fs::create_directories(rootFolder + "/golden");
+        if (failures > 0 || !saveGolden(goldenFile, results, stageTotals, calibrationMs)) {
+            std::cerr << "基准文件未更新" << std::endl;
+            return -1;
+        }
+        std::cout << "基准文件已更新: " << goldenFile << std::endl;
+        return 0;
+    }
+    
+    cv::FileStorage golden(goldenFile, cv::FileStorage::READ);
+    if (!golden.isOpened()) {
+        std::cerr << "无法读取基准文件: " << goldenFile << " (使用 --update 生成)" << std::endl;
+        return -1;
+    }
+    
+    // 精度检查
+    std::map<std::string, cv::FileNode> goldenPairs;
+    for (const auto& node : golden["pairs"]) {
+        goldenPairs[(std::string)node["name"]] = node;
+    }
+    
+    for (const auto& result : results) {
+        auto it = goldenPairs.find(result.name);
+        if (it == goldenPairs.end()) {
+            std::cerr << "[失败] " << result.name << ": 基准中没有该图像对" << std::endl;
+            failures++;
+            continue;
+        }
+        
+        cv::Mat goldenDisparity, goldenRectified;
+        double goldenValidRatio = 0.0;
+        it->second["disparity"] >> goldenDisparity;
+        it->second["rectified"] >> goldenRectified;
+        it->second["validRatio"] >> goldenValidRatio;
+        
+        double disparityDiff = disparityDifference(result.disparityThumb, goldenDisparity);
+        double validDiff = std::abs(result.validRatio - goldenValidRatio);
+        double rectifiedDiff = rectifiedDifference(result.rectifiedThumb, goldenRectified);
+        
+        bool passed = disparityDiff >= 0 && disparityDiff <= MAX_DISPARITY_DIFF &&
+                      validDiff <= MAX_VALID_RATIO_DIFF &&
+                      rectifiedDiff >= 0 && rectifiedDiff <= MAX_RECTIFIED_DIFF;
+        
+        std::cout << (passed ? "[通过] " : "[失败] ") << result.name
+                  << " 视差差异: " << disparityDiff
+                  << " 有效点比例: " << result.validRatio << " (基准 " << goldenValidRatio << ")"
+                  << " 矫正差异: " << rectifiedDiff << std::endl;
+        if (!passed) {
+            failures++;
+        }
+    }
+    
+    // 性能检查: 按阶段累计所有图像对的耗时, 降低单次计时的抖动; 基准乘以本次的校准耗时
+    // 换算为本机毫秒. 未指定 --timing 时超限只提示
+    cv::FileNode goldenTimings = golden["relativeTimings"];
+    for (const auto& stage : stageTotals) {
+        cv::FileNode node = goldenTimings[stage.first];
+        if (node.empty()) {
+            continue;
+        }
+        double baseline = (double)node * calibrationMs;
+        double limit = baseline * MAX_TIMING_RATIO + TIMING_SLACK_MS;
+        bool passed = stage.second <= limit;
+        
+        std::cout << (passed ? "[通过] " : (enforceTiming ? "[失败] " : "[提示] ")) << "阶段 " << stage.first
+                  << ": " << stage.second << " ms (基准 " << baseline << " ms, 上限 " << limit << " ms)" << std::endl;
+        if (!passed && enforceTiming) {
+            failures++;
+        }
+    }
+    
+    std::cout << "\n回归测试" << (failures == 0 ? "通过" : "失败") << ", 失败项: " << failures << std::endl;
+    return failures == 0 ? 0 : -1;
+}
\ No newline at end of file
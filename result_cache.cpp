@@ -0,0 +1,528 @@
+#include "result_cache.h"
+#include "image_io.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+namespace fs = std::filesystem;
+
+namespace ResultCache {
+
+// <key>.rcache layout (native endianness, every section 64-byte aligned so the arrays can be
+// used in place from the mapping):
+//   EntryHeader, then disparity (rows x cols float), points (N x 3 float), pixels (N int32),
+//   colors (N x 3 uchar), confidence (N float), normals (N x 3 float), metadata.
+// Metadata: uint32 timingCount, per timing uint32 nameLength, char[nameLength], double ms;
+//   uint32 planeCount, per plane double[4] coefficients, int32 inlierCount, double rmsDistance.
+// The header checksum is XXH64 over everything after the header, so a torn or foreign write is
+// rejected instead of being mapped as results.
+static const char kEntryMagic[4] = {'R', 'C', 'A', 'C'};
+static const uint32_t kEntryVersion = 2;
+static const size_t kSectionAlignment = 64;
+static const char* kEntryExtension = ".rcache";
+
+enum Section { DISPARITY = 0, POINTS, PIXELS, COLORS, CONFIDENCE, NORMALS, METADATA, SECTION_COUNT };
+
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    int32_t roi[4];
+    int32_t rows;
+    int32_t cols;
+    uint32_t pointCount;
+    uint32_t reserved;
+    uint64_t offsets[SECTION_COUNT];
+    uint64_t sizes[SECTION_COUNT];
+    uint64_t checksum;
+};
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : base(nullptr), length(0) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (base) {
+                    length = static_cast<size_t>(fileSize.QuadPart);
+                }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                base = address;
+                length = static_cast<size_t>(info.st_size);
+            }
+        }
+        close(fd);
+#endif
+    }
+    
+    ~MappedFile() {
+        if (!base) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap(base, length);
+#endif
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const unsigned char* data() const { return static_cast<const unsigned char*>(base); }
+    size_t size() const { return length; }
+
+private:
+    void* base;
+    size_t length;
+};
+
+static unsigned long currentProcessId() {
+#ifdef _WIN32
+    return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// Unique across the processes of a batch sharing one cache folder and the threads within each
+static std::string temporarySuffix() {
+    static std::atomic<uint64_t> counter(0);
+    return ".tmp" + std::to_string(currentProcessId()) + "_" +
+           std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "_" +
+           std::to_string(counter++);
+}
+
+template <typename T>
+static void appendPod(std::vector<char>& buffer, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+static bool readPod(const unsigned char* data, size_t size, size_t& offset, T& value) {
+    if (offset + sizeof(T) > size) {
+        return false;
+    }
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static void appendString(std::vector<char>& buffer, const std::string& text) {
+    appendPod(buffer, static_cast<uint32_t>(text.size()));
+    buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+bool computeKey(const StereoReconstruction::ReconstructionParams& params, uint64_t& key) {
+    uint64_t leftHash = 0, rightHash = 0, calibrationHash = 0;
+    if (!ImageIO::hashFile(params.leftImagePath, leftHash) ||
+        !ImageIO::hashFile(params.rightImagePath, rightHash, leftHash) ||
+        !ImageIO::hashFile(params.calibrationFile, calibrationHash, rightHash)) {
+        return false;
+    }
+    
+    std::vector<char> fields;
+    appendPod(fields, kEntryVersion);
+    appendPod(fields, params.useColorTexture);
+    appendPod(fields, params.quality);
+    appendPod(fields, params.maxDepth);
+    appendPod(fields, params.minDepth);
+    appendPod(fields, params.algorithm);
+    appendPod(fields, params.postProcessing);
+    appendPod(fields, params.decodeScale);
+    appendPod(fields, static_cast<uint64_t>(params.matchMemoryBudget));
+    appendPod(fields, params.timeBudgetMs);
+    appendString(fields, params.latencyProfileFile);
+    appendPod(fields, params.removeOutliers);
+    appendPod(fields, params.outlierParams.radius);
+    appendPod(fields, params.outlierParams.minNeighbors);
+    appendPod(fields, params.outlierParams.stdRatio);
+    appendPod(fields, params.computeNormals);
+    appendPod(fields, params.normalRadius);
+    appendPod(fields, params.extractPlanes);
+    appendPod(fields, params.planeParams.distanceThreshold);
+    appendPod(fields, params.planeParams.sampleStride);
+    appendPod(fields, params.planeParams.hypotheses);
+    appendPod(fields, params.planeParams.maxPlanes);
+    appendPod(fields, params.planeParams.minInliers);
+    appendPod(fields, params.planeParams.seed);
+    appendPod(fields, params.roiMode);
+    appendPod(fields, params.roi.x);
+    appendPod(fields, params.roi.y);
+    appendPod(fields, params.roi.width);
+    appendPod(fields, params.roi.height);
+    
+    key = ImageIO::hashBytes(fields.data(), fields.size(), calibrationHash);
+    return true;
+}
+
+std::string entryPath(const std::string& cacheFolder, uint64_t key) {
+    return cacheFolder + "/" + ImageIO::hashToHex(key) + kEntryExtension;
+}
+
+static bool sectionInFile(const EntryHeader& header, int section, size_t fileSize) {
+    return header.offsets[section] <= fileSize && header.sizes[section] <= fileSize - header.offsets[section];
+}
+
+bool lookup(const std::string& cacheFolder, uint64_t key, CachedResult& result) {
+    std::string path = entryPath(cacheFolder, key);
+    std::error_code error;
+    if (!fs::exists(path, error)) {
+        return false;
+    }
+    
+    auto mapping = std::make_shared<const MappedFile>(path);
+    const unsigned char* data = mapping->data();
+    size_t size = mapping->size();
+    
+    EntryHeader header;
+    if (!data || size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kEntryMagic, 4) != 0 || header.version != kEntryVersion ||
+        header.key != key || header.rows <= 0 || header.cols <= 0) {
+        std::cerr << "Ignoring incompatible cache entry: " << path << std::endl;
+        return false;
+    }
+    
+    size_t n = header.pointCount;
+    size_t expected[SECTION_COUNT] = {
+        static_cast<size_t>(header.rows) * header.cols * sizeof(float), n * sizeof(cv::Vec3f),
+        n * sizeof(int32_t), n * sizeof(cv::Vec3b), n * sizeof(float), n * sizeof(cv::Vec3f), 0
+    };
+    for (int section = 0; section < SECTION_COUNT; section++) {
+        bool optional = section == COLORS || section == CONFIDENCE || section == NORMALS;
+        bool sizeOk = section == METADATA || header.sizes[section] == expected[section] ||
+                      (optional && header.sizes[section] == 0);
+        if (!sizeOk || !sectionInFile(header, section, size)) {
+            std::cerr << "Truncated cache entry: " << path << std::endl;
+            return false;
+        }
+    }
+    
+    if (ImageIO::hashBytes(data + sizeof(header), size - sizeof(header)) != header.checksum) {
+        std::cerr << "Corrupt cache entry: " << path << std::endl;
+        return false;
+    }
+    
+    // Views into the read-only mapping; callers must not write through them
+    auto view = [&](int section, int rows, int cols, int type) {
+        if (header.sizes[section] == 0 || rows == 0) {
+            return cv::Mat();
+        }
+        return cv::Mat(rows, cols, type, const_cast<unsigned char*>(data + header.offsets[section]));
+    };
+    int count = static_cast<int>(n);
+    result.disparity = view(DISPARITY, header.rows, header.cols, CV_32FC1);
+    result.points = view(POINTS, count, 1, CV_32FC3);
+    result.pixels = view(PIXELS, count, 1, CV_32SC1);
+    result.colors = view(COLORS, count, 1, CV_8UC3);
+    result.confidence = view(CONFIDENCE, count, 1, CV_32FC1);
+    result.normals = view(NORMALS, count, 1, CV_32FC3);
+    result.roi = cv::Rect(header.roi[0], header.roi[1], header.roi[2], header.roi[3]);
+    
+    const unsigned char* metadata = data + header.offsets[METADATA];
+    size_t metadataSize = header.sizes[METADATA];
+    size_t offset = 0;
+    uint32_t timingCount = 0, planeCount = 0;
+    result.stageTimings.clear();
+    result.planes.clear();
+    
+    if (!readPod(metadata, metadataSize, offset, timingCount)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < timingCount; i++) {
+        uint32_t nameLength = 0;
+        StereoReconstruction::StageTiming timing;
+        if (!readPod(metadata, metadataSize, offset, nameLength) || offset + nameLength > metadataSize) {
+            return false;
+        }
+        timing.stage.assign(reinterpret_cast<const char*>(metadata + offset), nameLength);
+        offset += nameLength;
+        if (!readPod(metadata, metadataSize, offset, timing.milliseconds)) {
+            return false;
+        }
+        result.stageTimings.push_back(timing);
+    }
+    
+    if (!readPod(metadata, metadataSize, offset, planeCount)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < planeCount; i++) {
+        PlaneSegmentation::Plane plane;
+        int32_t inlierCount = 0;
+        for (int c = 0; c < 4; c++) {
+            if (!readPod(metadata, metadataSize, offset, plane.coefficients[c])) {
+                return false;
+            }
+        }
+        if (!readPod(metadata, metadataSize, offset, inlierCount) ||
+            !readPod(metadata, metadataSize, offset, plane.rmsDistance)) {
+            return false;
+        }
+        plane.inlierCount = inlierCount;
+        result.planes.push_back(plane);
+    }
+    
+    result.mapping = mapping;
+    
+    // Access time drives eviction
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool store(const std::string& cacheFolder, uint64_t key,
+           const StereoReconstruction::ReconstructionOutput& output, const CacheLimits& limits) {
+    const cv::Mat& disparity = output.depthMap;
+    const cv::Mat& cloud = output.pointCloud3D;
+    if (disparity.empty() || disparity.type() != CV_32FC1 || cloud.type() != CV_32FC3 ||
+        cloud.size() != disparity.size()) {
+        return false;
+    }
+    
+    bool hasColors = output.rectifiedLeft.type() == CV_8UC3 && output.rectifiedLeft.size() == cloud.size();
+    bool hasConfidence = output.confidenceMap.type() == CV_32FC1 && output.confidenceMap.size() == cloud.size();
+    bool hasNormals = output.normals.type() == CV_32FC3 && output.normals.size() == cloud.size();
+    
+    // Compact cloud: finite points only, with their pixel for re-expansion
+    std::vector<cv::Vec3f> points;
+    std::vector<int32_t> pixels;
+    std::vector<cv::Vec3b> colors;
+    std::vector<float> confidence;
+    std::vector<cv::Vec3f> normals;
+    for (int y = 0; y < cloud.rows; y++) {
+        const cv::Vec3f* row = cloud.ptr<cv::Vec3f>(y);
+        for (int x = 0; x < cloud.cols; x++) {
+            const cv::Vec3f& p = row[x];
+            if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2])) {
+                continue;
+            }
+            points.push_back(p);
+            pixels.push_back(y * cloud.cols + x);
+            if (hasColors) {
+                colors.push_back(output.rectifiedLeft.at<cv::Vec3b>(y, x));
+            }
+            if (hasConfidence) {
+                confidence.push_back(output.confidenceMap.at<float>(y, x));
+            }
+            if (hasNormals) {
+                normals.push_back(output.normals.at<cv::Vec3f>(y, x));
+            }
+        }
+    }
+    
+    std::vector<char> metadata;
+    appendPod(metadata, static_cast<uint32_t>(output.stageTimings.size()));
+    for (const auto& timing : output.stageTimings) {
+        appendString(metadata, timing.stage);
+        appendPod(metadata, timing.milliseconds);
+    }
+    appendPod(metadata, static_cast<uint32_t>(output.planes.size()));
+    for (const auto& plane : output.planes) {
+        for (int c = 0; c < 4; c++) {
+            appendPod(metadata, plane.coefficients[c]);
+        }
+        appendPod(metadata, static_cast<int32_t>(plane.inlierCount));
+        appendPod(metadata, plane.rmsDistance);
+    }
+    
+    EntryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kEntryMagic, 4);
+    header.version = kEntryVersion;
+    header.key = key;
+    header.roi[0] = output.roi.x;
+    header.roi[1] = output.roi.y;
+    header.roi[2] = output.roi.width;
+    header.roi[3] = output.roi.height;
+    header.rows = disparity.rows;
+    header.cols = disparity.cols;
+    header.pointCount = static_cast<uint32_t>(points.size());
+    
+    const void* sources[SECTION_COUNT] = {
+        nullptr, points.data(), pixels.data(), colors.data(), confidence.data(), normals.data(), metadata.data()
+    };
+    size_t sizes[SECTION_COUNT] = {
+        static_cast<size_t>(disparity.rows) * disparity.cols * sizeof(float),
+        points.size() * sizeof(cv::Vec3f), pixels.size() * sizeof(int32_t),
+        colors.size() * sizeof(cv::Vec3b), confidence.size() * sizeof(float),
+        normals.size() * sizeof(cv::Vec3f), metadata.size()
+    };
+    
+    size_t offset = sizeof(header);
+    for (int section = 0; section < SECTION_COUNT; section++) {
+        offset = (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+        header.offsets[section] = offset;
+        header.sizes[section] = sizes[section];
+        offset += sizes[section];
+    }
+    
+    std::vector<char> buffer(offset, 0);
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    for (int y = 0; y < disparity.rows; y++) {
+        std::memcpy(buffer.data() + header.offsets[DISPARITY] + y * disparity.cols * sizeof(float),
+                    disparity.ptr<float>(y), disparity.cols * sizeof(float));
+    }
+    for (int section = POINTS; section < SECTION_COUNT; section++) {
+        if (sizes[section] > 0) {
+            std::memcpy(buffer.data() + header.offsets[section], sources[section], sizes[section]);
+        }
+    }
+    header.checksum = ImageIO::hashBytes(buffer.data() + sizeof(header), buffer.size() - sizeof(header));
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    
+    try {
+        fs::create_directories(cacheFolder);
+        
+        // Unique temporary name so concurrent writers of the same key never interleave
+        std::string path = entryPath(cacheFolder, key);
+        std::string tempPath = path + temporarySuffix();
+        {
+            std::ofstream file(tempPath, std::ios::binary);
+            if (!file.is_open() || !file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+                std::cerr << "Cannot write cache entry: " << tempPath << std::endl;
+                return false;
+            }
+        }
+        
+        std::error_code error;
+        fs::rename(tempPath, path, error);
+        if (error) {
+            fs::remove(tempPath, error);
+            return false;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error writing result cache: " << e.what() << std::endl;
+        return false;
+    }
+    
+    enforceLimits(cacheFolder, limits);
+    return true;
+}
+
+int enforceLimits(const std::string& cacheFolder, const CacheLimits& limits) {
+    struct Entry {
+        fs::path path;
+        uintmax_t bytes;
+        fs::file_time_type accessed;
+    };
+    
+    std::vector<Entry> entries;
+    uintmax_t totalBytes = 0;
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(cacheFolder, error)) {
+        if (item.is_regular_file(error) && item.path().extension() == kEntryExtension) {
+            Entry entry{item.path(), item.file_size(error), item.last_write_time(error)};
+            totalBytes += entry.bytes;
+            entries.push_back(entry);
+        }
+    }
+    
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.accessed < b.accessed;
+    });
+    
+    size_t maxEntries = limits.maxEntries > 0 ? limits.maxEntries : std::numeric_limits<size_t>::max();
+    uintmax_t maxBytes = limits.maxBytes > 0 ? limits.maxBytes : std::numeric_limits<uintmax_t>::max();
+    
+    // An entry still mapped by a reader stays valid on POSIX; on Windows its removal fails
+    // and is retried on the next store
+    int removed = 0;
+    size_t remaining = entries.size();
+    for (const auto& entry : entries) {
+        if (remaining <= maxEntries && totalBytes <= maxBytes) {
+            break;
+        }
+        if (fs::remove(entry.path, error)) {
+            totalBytes -= entry.bytes;
+            remaining--;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+void expand(const CachedResult& cached, StereoReconstruction::ReconstructionOutput& output) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    cv::Size size = cached.disparity.size();
+    
+    output.depthMap = cached.disparity.clone();
+    output.pointCloud3D.create(size, CV_32FC3);
+    output.pointCloud3D.setTo(cv::Scalar::all(nan));
+    output.confidenceMap.release();
+    output.normals.release();
+    output.pointColors.release();
+    
+    if (!cached.confidence.empty()) {
+        output.confidenceMap = cv::Mat::zeros(size, CV_32FC1);
+    }
+    if (!cached.normals.empty()) {
+        output.normals.create(size, CV_32FC3);
+        output.normals.setTo(cv::Scalar::all(nan));
+    }
+    if (!cached.colors.empty()) {
+        output.pointColors = cv::Mat::zeros(size, CV_8UC3);
+    }
+    
+    cv::Vec3f* cloud = output.pointCloud3D.ptr<cv::Vec3f>();
+    for (int i = 0; i < cached.points.rows; i++) {
+        int pixel = cached.pixels.at<int32_t>(i);
+        if (pixel < 0 || pixel >= size.area()) {
+            continue;
+        }
+        cloud[pixel] = cached.points.at<cv::Vec3f>(i);
+        if (!output.confidenceMap.empty()) {
+            output.confidenceMap.ptr<float>()[pixel] = cached.confidence.at<float>(i);
+        }
+        if (!output.normals.empty()) {
+            output.normals.ptr<cv::Vec3f>()[pixel] = cached.normals.at<cv::Vec3f>(i);
+        }
+        if (!output.pointColors.empty()) {
+            output.pointColors.ptr<cv::Vec3b>()[pixel] = cached.colors.at<cv::Vec3b>(i);
+        }
+    }
+    
+    output.roi = cached.roi;
+    output.planes = cached.planes;
+    output.stageTimings = cached.stageTimings;
+    output.fromCache = true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ResultCache {
+    // Oldest-accessed entries are evicted until both limits hold; 0 disables a limit
+    struct CacheLimits {
+        size_t maxBytes = size_t(1) << 30;
+        size_t maxEntries = 0;
+    };
+    
+    class MappedFile;
+    
+    // One entry mapped read-only. The matrices point into the mapping and stay valid while
+    // this object (or a copy of it) is alive; the cloud holds finite points only.
+    struct CachedResult {
+        std::shared_ptr<const MappedFile> mapping;
+        cv::Mat disparity;   // CV_32F, roi-sized
+        cv::Mat points;      // N x 1 CV_32FC3
+        cv::Mat pixels;      // N x 1 CV_32S, y * disparity.cols + x
+        cv::Mat colors;      // N x 1 CV_8UC3, empty when the pair was decoded as grayscale
+        cv::Mat confidence;  // N x 1 CV_32F, may be empty
+        cv::Mat normals;     // N x 1 CV_32FC3, only with computeNormals
+        cv::Rect roi;
+        std::vector<StereoReconstruction::StageTiming> stageTimings;
+        std::vector<PlaneSegmentation::Plane> planes; // inlier masks are not cached
+    };
+    
+    // Hash of both encoded images, the calibration file and every parameter that changes the
+    // result; export-only settings (output folder, format, minConfidence) are left out
+    bool computeKey(const StereoReconstruction::ReconstructionParams& params, uint64_t& key);
+    
+    std::string entryPath(const std::string& cacheFolder, uint64_t key);
+    
+    // Maps the entry and refreshes its access time for LRU eviction
+    bool lookup(const std::string& cacheFolder, uint64_t key, CachedResult& result);
+    
+    // Writes the entry atomically (temp file + rename) and then enforces the limits
+    bool store(const std::string& cacheFolder, uint64_t key,
+               const StereoReconstruction::ReconstructionOutput& output,
+               const CacheLimits& limits = CacheLimits());
+    
+    // Removes least recently used entries; returns how many were removed
+    int enforceLimits(const std::string& cacheFolder, const CacheLimits& limits);
+    
+    // Organized maps (disparity, cloud, confidence, normals, point colors) for the writers and
+    // the stage timings of the run that produced the entry; rectified images and the residual
+    // map are not restored
+    void expand(const CachedResult& cached, StereoReconstruction::ReconstructionOutput& output);
+}
\ No newline at end of file
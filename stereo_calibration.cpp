@@ -1,4 +1,5 @@
 #include "stereo_calibration.h"
+#include "corner_detection.h"
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <fstream>
@@ -71,6 +72,70 @@ StereoCalibrationResult calibrateFromPoints(const std::vector<std::vector<cv::Po
     return result;
 }
 
+StereoCalibrationResult calibrateFromCornerFiles(const std::string& leftCornerFile,
+                                                const std::string& rightCornerFile,
+                                                const std::string& outputFolder,
+                                                float squareSize) {
+    StereoCalibrationResult result;
+    result.success = false;
+    
+    CornerDetection::CornerSet leftSet, rightSet;
+    if (!CornerDetection::loadCornerSet(leftCornerFile, leftSet) ||
+        !CornerDetection::loadCornerSet(rightCornerFile, rightSet)) {
+        return result;
+    }
+    
+    std::vector<std::vector<cv::Point2f>> leftPoints, rightPoints;
+    std::vector<std::vector<cv::Point3f>> objectPoints;
+    if (!CornerDetection::buildStereoPoints(leftSet, rightSet, squareSize,
+                                            leftPoints, rightPoints, objectPoints)) {
+        std::cerr << "No matching left/right views in corner sets" << std::endl;
+        return result;
+    }
+    
+    std::cout << "Loaded " << leftPoints.size() << " stereo views from corner sets" << std::endl;
+    
+    result = calibrateFromPoints(leftPoints, rightPoints, objectPoints, leftSet.imageSize);
+    if (result.success && !outputFolder.empty()) {
+        fs::create_directories(outputFolder);
+        saveCalibrationXML(result, outputFolder + "/opencv_calibration.xml");
+    }
+    
+    return result;
+}
+
+StereoCalibrationResult scaleCalibration(const StereoCalibrationResult& result, int reduction) {
+    StereoCalibrationResult scaled = result;
+    if (reduction <= 1) {
+        return scaled;
+    }
+    
+    const double s = 1.0 / reduction;
+    scaled.cameraMatrix1 = result.cameraMatrix1.clone();
+    scaled.cameraMatrix2 = result.cameraMatrix2.clone();
+    scaled.P1 = result.P1.clone();
+    scaled.P2 = result.P2.clone();
+    scaled.Q = result.Q.clone();
+    
+    // fx, fy, cx, cy (and the fx*Tx term of P2) shrink with the pixel grid
+    scaled.cameraMatrix1.rowRange(0, 2) *= s;
+    scaled.cameraMatrix2.rowRange(0, 2) *= s;
+    scaled.P1.rowRange(0, 2) *= s;
+    scaled.P2.rowRange(0, 2) *= s;
+    
+    // Q maps (x, y, d, 1) to homogeneous XYZ; every pixel-unit term scales, -1/Tx does not
+    scaled.Q.at<double>(0, 3) *= s;
+    scaled.Q.at<double>(1, 3) *= s;
+    scaled.Q.at<double>(2, 3) *= s;
+    scaled.Q.at<double>(3, 3) *= s;
+    
+    scaled.roi1 = cv::Rect(result.roi1.x / reduction, result.roi1.y / reduction,
+                           result.roi1.width / reduction, result.roi1.height / reduction);
+    scaled.roi2 = cv::Rect(result.roi2.x / reduction, result.roi2.y / reduction,
+                           result.roi2.width / reduction, result.roi2.height / reduction);
+    return scaled;
+}
+
 bool saveCalibrationXML(const StereoCalibrationResult& result, const std::string& filename) {
     cv::FileStorage fs(filename, cv::FileStorage::WRITE);
     if (!fs.isOpened()) {
@@ -27,6 +27,15 @@ namespace StereoCalibration {
                                                const std::vector<std::vector<cv::Point3f>>& objectPoints,
                                                cv::Size imageSize);
     
+    // Recalibrate from corners.bin files written by corner detection (no image decoding)
+    StereoCalibrationResult calibrateFromCornerFiles(const std::string& leftCornerFile,
+                                                    const std::string& rightCornerFile,
+                                                    const std::string& outputFolder,
+                                                    float squareSize);
+    
+    // Adapt intrinsics, rectification and Q to images decoded at 1/reduction resolution
+    StereoCalibrationResult scaleCalibration(const StereoCalibrationResult& result, int reduction);
+    
     bool saveCalibrationXML(const StereoCalibrationResult& result, const std::string& filename);
     
     bool loadCalibrationXML(const std::string& filename, StereoCalibrationResult& result);
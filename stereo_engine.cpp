@@ -0,0 +1,422 @@
+#include "stereo_engine.h"
+#include <opencv2/opencv.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace StereoReconstruction {
+
+// Same result as cv::reprojectImageTo3D for the given rows; points3D must be allocated
+static void reprojectRows(const cv::Mat& disparity, const cv::Matx44d& Q, cv::Mat& points3D,
+                          const cv::Range& rows) {
+    for (int y = rows.start; y < rows.end; y++) {
+        const float* d = disparity.ptr<float>(y);
+        cv::Vec3f* out = points3D.ptr<cv::Vec3f>(y);
+        
+        // Terms constant along the row
+        double bx = Q(0, 1) * y + Q(0, 3);
+        double by = Q(1, 1) * y + Q(1, 3);
+        double bz = Q(2, 1) * y + Q(2, 3);
+        double bw = Q(3, 1) * y + Q(3, 3);
+        
+        for (int x = 0; x < disparity.cols; x++) {
+            double X = Q(0, 0) * x + Q(0, 2) * d[x] + bx;
+            double Y = Q(1, 0) * x + Q(1, 2) * d[x] + by;
+            double Z = Q(2, 0) * x + Q(2, 2) * d[x] + bz;
+            double W = Q(3, 0) * x + Q(3, 2) * d[x] + bw;
+            double invW = (W != 0.0) ? 1.0 / W : 0.0;
+            out[x] = cv::Vec3f(static_cast<float>(X * invW),
+                               static_cast<float>(Y * invW),
+                               static_cast<float>(Z * invW));
+        }
+    }
+}
+
+// Same result as cv::reprojectImageTo3D, row-parallel and without per-call scratch buffers
+static void reprojectDisparity(const cv::Mat& disparity, const cv::Matx44d& Q, cv::Mat& points3D) {
+    points3D.create(disparity.size(), CV_32FC3);
+    
+    cv::parallel_for_(cv::Range(0, disparity.rows), [&](const cv::Range& range) {
+        reprojectRows(disparity, Q, points3D, range);
+    });
+}
+
+StereoEngine::StereoEngine()
+    : nextBuffer(0), matcherAlgorithm(1), matcherQuality(3), bandPool(nullptr), initialized(false) {
+}
+
+bool StereoEngine::initialize(const std::string& calibrationFile, cv::Size imageSize,
+                              int algorithm, int quality, int poolSize) {
+    StereoCalibration::StereoCalibrationResult calibration;
+    if (!StereoCalibration::loadCalibrationXML(calibrationFile, calibration)) {
+        std::cerr << "Cannot load calibration data" << std::endl;
+        return false;
+    }
+    return initialize(calibration, imageSize, algorithm, quality, poolSize);
+}
+
+bool StereoEngine::initialize(const StereoCalibration::StereoCalibrationResult& calibration,
+                              cv::Size imageSize, int algorithm, int quality, int poolSize) {
+    initialized = false;
+    
+    if (imageSize.area() <= 0 || poolSize < 1) {
+        std::cerr << "Invalid engine configuration" << std::endl;
+        return false;
+    }
+    
+    try {
+        calibData = calibration;
+        frameSize = imageSize;
+        disparityToDepth = cv::Matx44d(calibData.Q);
+        matcher = createMatcher(algorithm, quality);
+        matcherAlgorithm = algorithm;
+        matcherQuality = quality;
+        resetBands();
+        
+        cv::initUndistortRectifyMap(calibData.cameraMatrix1, calibData.distCoeffs1,
+                                   calibData.R1, calibData.P1, frameSize,
+                                   CV_16SC2, map1x, map1y);
+        cv::initUndistortRectifyMap(calibData.cameraMatrix2, calibData.distCoeffs2,
+                                   calibData.R2, calibData.P2, frameSize,
+                                   CV_16SC2, map2x, map2y);
+        
+        // Colormap as a lookup table so residual colorization needs no temporaries
+        cv::Mat ramp(1, 256, CV_8UC1);
+        for (int i = 0; i < 256; i++) {
+            ramp.at<uchar>(0, i) = static_cast<uchar>(i);
+        }
+        cv::applyColorMap(ramp, residualLut, cv::COLORMAP_JET);
+        
+        pool.assign(poolSize, FrameBuffers());
+        for (auto& buffers : pool) {
+            allocateBuffers(buffers, CV_8UC3);
+        }
+        nextBuffer = 0;
+        initialized = true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing stereo engine: " << e.what() << std::endl;
+    }
+    
+    return initialized;
+}
+
+void StereoEngine::setBandPool(Threading::TaskPool* pool) {
+    bandPool = pool;
+    resetBands();
+}
+
+void StereoEngine::resetBands() {
+    bands.clear();
+    if (!bandPool) {
+        return;
+    }
+    // Matchers keep per-call buffers, so each band has its own
+    bands.resize(bandPool->threadCount());
+    for (auto& band : bands) {
+        band.matcher = createMatcher(matcherAlgorithm, matcherQuality);
+    }
+}
+
+void StereoEngine::processBands(FrameBuffers& buffers, const cv::Mat& leftImage, const cv::Mat& rightImage) {
+    const int height = frameSize.height;
+    const int bandCount = static_cast<int>(bands.size());
+    const int coreRows = (height + bandCount - 1) / bandCount;
+    
+    // Rows shared with the neighbouring bands, as in computeDepthMapStriped
+    const int blockSize = bands[0].matcher->getBlockSize();
+    const int overlap = (matcherAlgorithm == 1) ? blockSize + 32 : blockSize / 2 + 8;
+    
+    // Each stage writes only its band's core rows; the next stage starts once all bands are
+    // done, so rows read from a neighbouring band are complete
+    Threading::TaskGroup group(*bandPool);
+    std::atomic<bool> failed(false);
+    auto runStage = [&](const std::function<void(BandState&, const cv::Range&)>& stage) {
+        for (int b = 0; b < bandCount; b++) {
+            cv::Range core(b * coreRows, std::min(height, (b + 1) * coreRows));
+            if (core.start >= core.end) {
+                break;
+            }
+            BandState* band = &bands[b];
+            group.post([&stage, &failed, band, core] {
+                try {
+                    stage(*band, core);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error in stereo engine band: " << e.what() << std::endl;
+                    failed = true;
+                }
+            });
+        }
+        group.wait();
+        if (failed) {
+            throw std::runtime_error("band processing failed");
+        }
+    };
+    
+    // Rectify images
+    runStage([&](BandState&, const cv::Range& core) {
+        cv::Mat rectifiedLeft = buffers.rectifiedLeft.rowRange(core);
+        cv::Mat rectifiedRight = buffers.rectifiedRight.rowRange(core);
+        cv::remap(leftImage, rectifiedLeft, map1x.rowRange(core), map1y.rowRange(core), cv::INTER_LINEAR);
+        cv::remap(rightImage, rectifiedRight, map2x.rowRange(core), map2y.rowRange(core), cv::INTER_LINEAR);
+        
+        cv::Mat leftGray = buffers.leftGray.rowRange(core);
+        cv::Mat rightGray = buffers.rightGray.rowRange(core);
+        if (leftImage.channels() == 3) {
+            cv::cvtColor(rectifiedLeft, leftGray, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(rectifiedRight, rightGray, cv::COLOR_BGR2GRAY);
+        } else {
+            rectifiedLeft.copyTo(leftGray);
+            rectifiedRight.copyTo(rightGray);
+        }
+    });
+    
+    // Match the band with its overlap, keep the core rows and score the row-local residual
+    runStage([&](BandState& band, const cv::Range& core) {
+        cv::Range rows(std::max(0, core.start - overlap), std::min(height, core.end + overlap));
+        band.matcher->compute(buffers.leftGray.rowRange(rows), buffers.rightGray.rowRange(rows),
+                              band.rawDisparity);
+        
+        cv::Mat rawDisparity = buffers.rawDisparity.rowRange(core);
+        cv::Mat disparity = buffers.disparity.rowRange(core);
+        cv::Mat residualValues = buffers.residualValues.rowRange(core);
+        band.rawDisparity.rowRange(core.start - rows.start, core.end - rows.start).copyTo(rawDisparity);
+        rawDisparity.convertTo(disparity, CV_32F, 1.0/16.0);
+        computeWarpedResidual(buffers.leftGray.rowRange(core), buffers.rightGray.rowRange(core),
+                              disparity, residualValues);
+    });
+    
+    // Confidence reads one row above and below, so it runs on the core plus those rows
+    runStage([&](BandState& band, const cv::Range& core) {
+        cv::Range rows(std::max(0, core.start - 1), std::min(height, core.end + 1));
+        computeMatchConfidence(buffers.leftGray.rowRange(rows), buffers.disparity.rowRange(rows),
+                               buffers.residualValues.rowRange(rows), band.confidence);
+        cv::Mat confidence = buffers.confidence.rowRange(core);
+        band.confidence.rowRange(core.start - rows.start, core.end - rows.start).copyTo(confidence);
+        
+        reprojectRows(buffers.disparity, disparityToDepth, buffers.pointCloud3D, core);
+        
+        cv::Mat residualValues = buffers.residualValues.rowRange(core);
+        cv::Mat residual = buffers.residual.rowRange(core);
+        cv::Mat invalidMask = buffers.invalidMask.rowRange(core);
+        cv::Mat residualColor = buffers.residualColor.rowRange(core);
+        cv::Mat residualMap = buffers.residualMap.rowRange(core);
+        residualValues.convertTo(residual, CV_8U);
+        cv::compare(residualValues, residualValues, invalidMask, cv::CMP_NE);
+        cv::cvtColor(residual, residualColor, cv::COLOR_GRAY2BGR);
+        cv::LUT(residualColor, residualLut, residualMap);
+        residualMap.setTo(cv::Scalar::all(0), invalidMask);
+    });
+}
+
+void StereoEngine::allocateBuffers(FrameBuffers& buffers, int imageType) {
+    // create() is a no-op once size and type match, which keeps steady state allocation free
+    buffers.rectifiedLeft.create(frameSize, imageType);
+    buffers.rectifiedRight.create(frameSize, imageType);
+    buffers.leftGray.create(frameSize, CV_8UC1);
+    buffers.rightGray.create(frameSize, CV_8UC1);
+    buffers.rawDisparity.create(frameSize, CV_16SC1);
+    buffers.disparity.create(frameSize, CV_32FC1);
+    buffers.pointCloud3D.create(frameSize, CV_32FC3);
+    buffers.confidence.create(frameSize, CV_32FC1);
+    buffers.residualValues.create(frameSize, CV_32FC1);
+    buffers.residual.create(frameSize, CV_8UC1);
+    buffers.residualColor.create(frameSize, CV_8UC3);
+    buffers.residualMap.create(frameSize, CV_8UC3);
+    buffers.invalidMask.create(frameSize, CV_8UC1);
+}
+
+bool StereoEngine::process(const cv::Mat& leftImage, const cv::Mat& rightImage,
+                           ReconstructionOutput& output) {
+    output.success = false;
+    
+    if (!initialized) {
+        std::cerr << "Stereo engine is not initialized" << std::endl;
+        return false;
+    }
+    
+    if (leftImage.size() != frameSize || rightImage.size() != frameSize ||
+        leftImage.type() != rightImage.type()) {
+        std::cerr << "Frame size/type does not match the engine configuration" << std::endl;
+        return false;
+    }
+    
+    try {
+        FrameBuffers& buffers = pool[nextBuffer];
+        nextBuffer = (nextBuffer + 1) % pool.size();
+        allocateBuffers(buffers, leftImage.type());
+        
+        if (!bands.empty()) {
+            processBands(buffers, leftImage, rightImage);
+        } else {
+            // Rectify images
+            cv::remap(leftImage, buffers.rectifiedLeft, map1x, map1y, cv::INTER_LINEAR);
+            cv::remap(rightImage, buffers.rectifiedRight, map2x, map2y, cv::INTER_LINEAR);
+            
+            if (leftImage.channels() == 3) {
+                cv::cvtColor(buffers.rectifiedLeft, buffers.leftGray, cv::COLOR_BGR2GRAY);
+                cv::cvtColor(buffers.rectifiedRight, buffers.rightGray, cv::COLOR_BGR2GRAY);
+            } else {
+                buffers.rectifiedLeft.copyTo(buffers.leftGray);
+                buffers.rectifiedRight.copyTo(buffers.rightGray);
+            }
+            
+            // Compute depth map
+            matcher->compute(buffers.leftGray, buffers.rightGray, buffers.rawDisparity);
+            buffers.rawDisparity.convertTo(buffers.disparity, CV_32F, 1.0/16.0);
+            
+            // The warped residual feeds both the confidence and the residual map
+            computeWarpedResidual(buffers.leftGray, buffers.rightGray, buffers.disparity,
+                                  buffers.residualValues);
+            computeMatchConfidence(buffers.leftGray, buffers.disparity, buffers.residualValues,
+                                   buffers.confidence);
+            
+            // Compute 3D points
+            reprojectDisparity(buffers.disparity, disparityToDepth, buffers.pointCloud3D);
+            
+            // Compute residual map
+            buffers.residualValues.convertTo(buffers.residual, CV_8U);
+            cv::compare(buffers.residualValues, buffers.residualValues, buffers.invalidMask, cv::CMP_NE);
+            cv::cvtColor(buffers.residual, buffers.residualColor, cv::COLOR_GRAY2BGR);
+            cv::LUT(buffers.residualColor, residualLut, buffers.residualMap);
+            buffers.residualMap.setTo(cv::Scalar::all(0), buffers.invalidMask);
+        }
+        
+        output.rectifiedLeft = buffers.rectifiedLeft;
+        output.rectifiedRight = buffers.rectifiedRight;
+        output.depthMap = buffers.disparity;
+        output.pointCloud3D = buffers.pointCloud3D;
+        output.confidenceMap = buffers.confidence;
+        output.residualMap = buffers.residualMap;
+        output.residualValues = buffers.residualValues;
+        output.success = true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error in stereo engine: " << e.what() << std::endl;
+    }
+    
+    return output.success;
+}
+
+bool StereoEngine::processSparse(const cv::Mat& leftImage, const cv::Mat& rightImage,
+                                 std::vector<SparsePoint>& points, const SparseMatchParams& params) {
+    points.clear();
+    
+    if (!initialized) {
+        std::cerr << "Stereo engine is not initialized" << std::endl;
+        return false;
+    }
+    
+    if (leftImage.size() != frameSize || rightImage.size() != frameSize ||
+        leftImage.type() != rightImage.type()) {
+        std::cerr << "Frame size/type does not match the engine configuration" << std::endl;
+        return false;
+    }
+    
+    try {
+        // Convert before remapping so only one plane per view goes through the maps
+        if (leftImage.channels() == 3) {
+            cv::cvtColor(leftImage, sparseLeft, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(rightImage, sparseRight, cv::COLOR_BGR2GRAY);
+        } else {
+            sparseLeft = leftImage;
+            sparseRight = rightImage;
+        }
+        cv::remap(sparseLeft, sparseLeftGray, map1x, map1y, cv::INTER_LINEAR);
+        cv::remap(sparseRight, sparseRightGray, map2x, map2y, cv::INTER_LINEAR);
+        
+        points = computeSparseDepth(sparseLeftGray, sparseRightGray, calibData.Q, params);
+        return true;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error in sparse preview: " << e.what() << std::endl;
+    }
+    
+    return false;
+}
+
+EngineGroup::EngineGroup() : nextEngine(0) {
+}
+
+bool EngineGroup::initialize(const StereoCalibration::StereoCalibrationResult& calibration,
+                             cv::Size imageSize, int algorithm, int quality, int engineCount,
+                             Threading::AffinityMode mode) {
+    waitIdle();
+    workers.clear();
+    bandPools.clear();
+    engines.clear();
+    
+    // One partition per engine; partitionCpus caps the count at the number of cores
+    std::vector<std::vector<int>> partitions = Threading::partitionCpus(engineCount, mode);
+    
+    for (size_t i = 0; i < partitions.size(); i++) {
+        // The driver may run anywhere in the partition; band workers get one core each, or the
+        // whole partition in NUMA mode
+        std::vector<std::vector<int>> affinity, bandAffinity;
+        if (mode != Threading::AFFINITY_NONE) {
+            affinity.push_back(partitions[i]);
+        }
+        if (mode == Threading::AFFINITY_CORES) {
+            for (int cpu : partitions[i]) {
+                bandAffinity.push_back({cpu});
+            }
+        } else {
+            bandAffinity = affinity;
+        }
+        engines.emplace_back(new StereoEngine());
+        bandPools.emplace_back(new Threading::TaskPool(std::max<int>(1, static_cast<int>(partitions[i].size())), bandAffinity));
+        workers.emplace_back(new Threading::TaskPool(1, affinity));
+        
+        // Initialized on its own worker so maps and buffers are first touched on that partition
+        bool success = false;
+        StereoEngine* engine = engines.back().get();
+        Threading::TaskPool* bands = bandPools.back().get();
+        workers.back()->post([&success, engine, bands, &calibration, imageSize, algorithm, quality] {
+            engine->setBandPool(bands);
+            success = engine->initialize(calibration, imageSize, algorithm, quality);
+        });
+        workers.back()->waitIdle();
+        
+        if (!success) {
+            workers.clear();
+            bandPools.clear();
+            engines.clear();
+            return false;
+        }
+    }
+    
+    if (engines.empty()) {
+        return false;
+    }
+    std::cout << "Engine group: " << engines.size() << " engines on separate core partitions, "
+              << bandPools.front()->threadCount() << " band workers on the first" << std::endl;
+    return true;
+}
+
+void EngineGroup::submit(const cv::Mat& leftImage, const cv::Mat& rightImage, FrameCallback callback) {
+    if (engines.empty()) {
+        std::cerr << "Engine group is not initialized" << std::endl;
+        return;
+    }
+    
+    int index = static_cast<int>(nextEngine++ % engines.size());
+    StereoEngine* engine = engines[index].get();
+    workers[index]->post([engine, index, leftImage, rightImage, callback] {
+        ReconstructionOutput output;
+        output.success = false;
+        bool success = engine->process(leftImage, rightImage, output);
+        if (callback) {
+            callback(index, success, output);
+        }
+    });
+}
+
+void EngineGroup::waitIdle() {
+    for (auto& worker : workers) {
+        worker->waitIdle();
+    }
+}
+
+}
\ No newline at end of file
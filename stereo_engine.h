@@ -0,0 +1,115 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include "stereo_calibration.h"
+#include "thread_config.h"
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace StereoReconstruction {
+    // Long-lived reconstruction session. The matcher, calibration, rectification maps and a
+    // pool of frame buffers are set up once; after the first frame of a given input type,
+    // process() runs without heap allocation (apart from task dispatch with a band pool).
+    class StereoEngine {
+    public:
+        StereoEngine();
+        
+        bool initialize(const std::string& calibrationFile, cv::Size imageSize,
+                        int algorithm, int quality, int poolSize = 2);
+        
+        bool initialize(const StereoCalibration::StereoCalibrationResult& calibration,
+                        cv::Size imageSize, int algorithm, int quality, int poolSize = 2);
+        
+        // Output matrices reference pooled buffers; they stay valid for poolSize - 1 further calls
+        bool process(const cv::Mat& leftImage, const cv::Mat& rightImage, ReconstructionOutput& output);
+        
+        // With a band pool, process() splits each frame into one row band per pool worker and
+        // runs rectification, matching (bands overlap as in computeDepthMapStriped) and the
+        // per-pixel stages on it instead of OpenCV's parallel_for_. Null restores the default.
+        // The pool must outlive its use and must not be the one process() is called from.
+        void setBandPool(Threading::TaskPool* pool);
+        
+        // Preview path: rectifies only the gray planes with the cached maps and triangulates
+        // FAST corners matched along the epipolar rows
+        bool processSparse(const cv::Mat& leftImage, const cv::Mat& rightImage,
+                           std::vector<SparsePoint>& points,
+                           const SparseMatchParams& params = SparseMatchParams());
+        
+        bool isInitialized() const { return initialized; }
+        cv::Size imageSize() const { return frameSize; }
+        const StereoCalibration::StereoCalibrationResult& calibration() const { return calibData; }
+        
+    private:
+        struct FrameBuffers {
+            cv::Mat rectifiedLeft, rectifiedRight;
+            cv::Mat leftGray, rightGray;
+            cv::Mat rawDisparity;  // CV_16S, 4 fractional bits
+            cv::Mat disparity;     // CV_32F
+            cv::Mat pointCloud3D;  // CV_32FC3
+            cv::Mat confidence;    // CV_32F
+            cv::Mat residualValues;  // CV_32F, NaN where disparity is invalid
+            cv::Mat residual, residualColor, residualMap, invalidMask;
+        };
+        
+        // Per-band matcher and scratch, reused across frames
+        struct BandState {
+            cv::Ptr<cv::StereoMatcher> matcher;
+            cv::Mat rawDisparity;
+            cv::Mat confidence;
+        };
+        
+        void allocateBuffers(FrameBuffers& buffers, int imageType);
+        void resetBands();
+        void processBands(FrameBuffers& buffers, const cv::Mat& leftImage, const cv::Mat& rightImage);
+        
+        StereoCalibration::StereoCalibrationResult calibData;
+        cv::Size frameSize;
+        cv::Matx44d disparityToDepth;
+        cv::Ptr<cv::StereoMatcher> matcher;
+        cv::Mat map1x, map1y, map2x, map2y;
+        cv::Mat residualLut;
+        cv::Mat sparseLeft, sparseRight;          // unrectified gray planes of the preview path
+        cv::Mat sparseLeftGray, sparseRightGray;  // rectified gray planes of the preview path
+        std::vector<FrameBuffers> pool;
+        size_t nextBuffer;
+        int matcherAlgorithm;
+        int matcherQuality;
+        Threading::TaskPool* bandPool;
+        std::vector<BandState> bands;
+        bool initialized;
+    };
+    
+    // Independent engines for throughput, each on its own core partition: one driver worker
+    // per engine and a band pool with one worker per core of the partition, so every core of
+    // a partition works on that engine's frames. OpenCV's pool is process-wide; configure it
+    // with opencvThreads = 1 so the matcher and parallel_for_ run inside the band workers
+    // instead of crossing into another partition.
+    class EngineGroup {
+    public:
+        using FrameCallback =
+            std::function<void(int engineIndex, bool success, const ReconstructionOutput& output)>;
+        
+        EngineGroup();
+        
+        bool initialize(const StereoCalibration::StereoCalibrationResult& calibration,
+                        cv::Size imageSize, int algorithm, int quality, int engineCount,
+                        Threading::AffinityMode mode = Threading::AFFINITY_CORES);
+        
+        // Frames are handed out round-robin and shared, not copied. The callback runs on the
+        // engine's worker while the output buffers are still valid.
+        void submit(const cv::Mat& leftImage, const cv::Mat& rightImage, FrameCallback callback);
+        
+        void waitIdle();
+        
+        int engineCount() const { return static_cast<int>(engines.size()); }
+        
+    private:
+        std::vector<std::unique_ptr<StereoEngine>> engines;
+        std::vector<std::unique_ptr<Threading::TaskPool>> bandPools; // destroyed before the engines
+        std::vector<std::unique_ptr<Threading::TaskPool>> workers;   // destroyed before the band pools
+        std::atomic<size_t> nextEngine;
+    };
+}
\ No newline at end of file
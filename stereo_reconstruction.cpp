@@ -1,43 +1,64 @@
 #include "stereo_reconstruction.h"
 #include "stereo_calibration.h"
+#include "block_matcher.h"
+#include "point_cloud_normals.h"
+#include "image_io.h"
+#include "latency_budget.h"
+#include "output_writer.h"
+#include "result_cache.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/calib3d.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 namespace fs = std::filesystem;
 
+// The residual kernel is written against the OpenCV 4.8+ universal intrinsics API (VTraits,
+// v_add, v_sub); older releases and builds without SIMD use the scalar loop
+#if CV_SIMD && (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 8))
+#define STEREO_SIMD_RESIDUAL 1
+#else
+#define STEREO_SIMD_RESIDUAL 0
+#endif
+
 namespace StereoReconstruction {
 
-cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight, 
-                       int algorithm, int quality) {
-    cv::Mat disparity;
-    cv::Mat depthMap;
-    
-    // Convert to grayscale if needed
-    cv::Mat leftGray, rightGray;
-    if (rectifiedLeft.channels() == 3) {
-        cv::cvtColor(rectifiedLeft, leftGray, cv::COLOR_BGR2GRAY);
-        cv::cvtColor(rectifiedRight, rightGray, cv::COLOR_BGR2GRAY);
-    } else {
-        leftGray = rectifiedLeft.clone();
-        rightGray = rectifiedRight.clone();
+MatcherConfig matcherConfigForQuality(int algorithm, int quality) {
+    MatcherConfig config;
+    config.algorithm = algorithm;
+    if (algorithm == 1) { // SGBM
+        config.blockSize = (quality <= 2) ? 3 : (quality <= 4) ? 5 : 7;
+    } else { // StereoBM and the SAD block matcher
+        config.blockSize = (quality <= 2) ? 15 : (quality <= 4) ? 21 : 25;
     }
+    config.numDisparities = 96;
+    config.downscale = 1;
+    return config;
+}
+
+cv::Ptr<cv::StereoMatcher> createMatcher(const MatcherConfig& config) {
+    int blockSize = config.blockSize;
+    int numDisparities = config.numDisparities;
     
-    if (algorithm == 1) { // SGBM
+    if (config.algorithm == 1) { // SGBM
         auto sgbm = cv::StereoSGBM::create();
-        
-        // Set parameters based on quality
-        int blockSize = (quality <= 2) ? 3 : (quality <= 4) ? 5 : 7;
-        int numDisparities = 96;
         int minDisparity = 0;
         
+        // Matching always runs on single-channel planes
         sgbm->setBlockSize(blockSize);
         sgbm->setNumDisparities(numDisparities);
         sgbm->setMinDisparity(minDisparity);
-        sgbm->setP1(8 * leftGray.channels() * blockSize * blockSize);
-        sgbm->setP2(32 * leftGray.channels() * blockSize * blockSize);
+        sgbm->setP1(8 * blockSize * blockSize);
+        sgbm->setP2(32 * blockSize * blockSize);
         sgbm->setDisp12MaxDiff(1);
         sgbm->setUniquenessRatio(10);
         sgbm->setSpeckleWindowSize(100);
@@ -45,32 +66,425 @@ cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRi
         sgbm->setPreFilterCap(63);
         sgbm->setMode(cv::StereoSGBM::MODE_SGBM);
         
-        sgbm->compute(leftGray, rightGray, disparity);
-    } else { // StereoBM
-        auto bm = cv::StereoBM::create();
+        return sgbm;
+    }
+    
+    if (config.algorithm == 3) { // SAD block matcher with compile-time specialized kernels
+        auto sad = cv::makePtr<BlockMatcher::SadBlockMatcher>(numDisparities, blockSize);
+        sad->setSpeckleWindowSize(100);
+        sad->setSpeckleRange(32);
+        return sad;
+    }
+    
+    // StereoBM
+    auto bm = cv::StereoBM::create();
+    
+    bm->setBlockSize(blockSize);
+    bm->setNumDisparities(numDisparities);
+    bm->setMinDisparity(0);
+    bm->setSpeckleWindowSize(100);
+    bm->setSpeckleRange(32);
+    bm->setDisp12MaxDiff(1);
+    
+    return bm;
+}
+
+cv::Ptr<cv::StereoMatcher> createMatcher(int algorithm, int quality) {
+    return createMatcher(matcherConfigForQuality(algorithm, quality));
+}
+
+// Warped residual and, when asked for, the confidence scored from it
+static void scoreMatches(const cv::Mat& leftGray, const cv::Mat& rightGray, const cv::Mat& depthMap,
+                         cv::Mat* confidence, cv::Mat* residual) {
+    if (!confidence && !residual) {
+        return;
+    }
+    cv::Mat localResidual;
+    cv::Mat& warped = residual ? *residual : localResidual;
+    computeWarpedResidual(leftGray, rightGray, depthMap, warped);
+    if (confidence) {
+        computeMatchConfidence(leftGray, depthMap, warped, *confidence);
+    }
+}
+
+cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight,
+                       const MatcherConfig& config, cv::Mat* confidence, cv::Mat* residual) {
+    cv::Mat disparity;
+    cv::Mat depthMap;
+    
+    // Convert to grayscale if needed
+    cv::Mat leftGray, rightGray;
+    if (rectifiedLeft.channels() == 3) {
+        cv::cvtColor(rectifiedLeft, leftGray, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(rectifiedRight, rightGray, cv::COLOR_BGR2GRAY);
+    } else {
+        leftGray = rectifiedLeft;
+        rightGray = rectifiedRight;
+    }
+    
+    if (config.downscale > 1) {
+        // Match a reduced pair; the disparity range shrinks with it (multiple of 16)
+        MatcherConfig reduced = config;
+        reduced.numDisparities = std::max(16, ((config.numDisparities / config.downscale + 15) / 16) * 16);
+        
+        double scale = 1.0 / config.downscale;
+        cv::Mat smallLeft, smallRight, smallDepth;
+        cv::resize(leftGray, smallLeft, cv::Size(), scale, scale, cv::INTER_AREA);
+        cv::resize(rightGray, smallRight, cv::Size(), scale, scale, cv::INTER_AREA);
+        
+        createMatcher(reduced)->compute(smallLeft, smallRight, disparity);
         
-        int blockSize = (quality <= 2) ? 15 : (quality <= 4) ? 21 : 25;
-        int numDisparities = 96;
+        // Back to full-resolution pixels; invalid values stay negative
+        disparity.convertTo(smallDepth, CV_32F, config.downscale / 16.0);
+        cv::resize(smallDepth, depthMap, leftGray.size(), 0, 0, cv::INTER_NEAREST);
+    } else {
+        cv::Ptr<cv::StereoMatcher> matcher = createMatcher(config);
+        matcher->compute(leftGray, rightGray, disparity);
+        
+        // Convert to proper depth map
+        disparity.convertTo(depthMap, CV_32F, 1.0/16.0);
+    }
+    
+    // Scored while the gray planes and disparity are still cache-resident
+    scoreMatches(leftGray, rightGray, depthMap, confidence, residual);
+    
+    return depthMap;
+}
+
+cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight, 
+                       int algorithm, int quality, cv::Mat* confidence, cv::Mat* residual) {
+    return computeDepthMap(rectifiedLeft, rectifiedRight,
+                           matcherConfigForQuality(algorithm, quality), confidence, residual);
+}
+
+static int patchSad(const cv::Mat& left, const cv::Mat& right, int xl, int xr, int y, int radius) {
+    int cost = 0;
+    for (int dy = -radius; dy <= radius; dy++) {
+        const uchar* l = left.ptr<uchar>(y + dy) + xl;
+        const uchar* r = right.ptr<uchar>(y + dy) + xr;
+        for (int dx = -radius; dx <= radius; dx++) {
+            cost += std::abs(l[dx] - r[dx]);
+        }
+    }
+    return cost;
+}
+
+std::vector<SparsePoint> computeSparseDepth(const cv::Mat& leftGray, const cv::Mat& rightGray,
+                                            const cv::Mat& Q, const SparseMatchParams& params) {
+    CV_Assert(leftGray.type() == CV_8UC1 && rightGray.type() == CV_8UC1 && leftGray.size() == rightGray.size());
+    
+    const int radius = params.patchSize / 2;
+    const int border = radius + params.rowTolerance + 2;
+    
+    std::vector<cv::KeyPoint> leftKeypoints, rightKeypoints;
+    cv::FAST(leftGray, leftKeypoints, params.fastThreshold, true);
+    cv::FAST(rightGray, rightKeypoints, params.fastThreshold, true);
+    cv::KeyPointsFilter::runByImageBorder(leftKeypoints, leftGray.size(), border);
+    cv::KeyPointsFilter::runByImageBorder(rightKeypoints, rightGray.size(), border);
+    cv::KeyPointsFilter::retainBest(leftKeypoints, params.maxFeatures);
+    
+    // Right corners bucketed by row, so each left corner only sees its epipolar band
+    std::vector<std::vector<int>> rightRows(rightGray.rows);
+    for (const auto& keypoint : rightKeypoints) {
+        rightRows[cvRound(keypoint.pt.y)].push_back(cvRound(keypoint.pt.x));
+    }
+    
+    const cv::Matx44d disparityToDepth(Q);
+    std::mutex pointsMutex;
+    std::vector<SparsePoint> points;
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(leftKeypoints.size())), [&](const cv::Range& range) {
+        std::vector<SparsePoint> localPoints;
         
-        bm->setBlockSize(blockSize);
-        bm->setNumDisparities(numDisparities);
-        bm->setMinDisparity(0);
-        bm->setSpeckleWindowSize(100);
-        bm->setSpeckleRange(32);
-        bm->setDisp12MaxDiff(1);
+        for (int i = range.start; i < range.end; i++) {
+            int x = cvRound(leftKeypoints[i].pt.x);
+            int y = cvRound(leftKeypoints[i].pt.y);
+            
+            int best = -1, bestCost = std::numeric_limits<int>::max(), secondCost = std::numeric_limits<int>::max();
+            for (int row = y - params.rowTolerance; row <= y + params.rowTolerance; row++) {
+                for (int xr : rightRows[row]) {
+                    if (xr > x || xr < x - params.numDisparities + 1) {
+                        continue;
+                    }
+                    // Rectified rows line up, so both patches are taken on the left corner's row
+                    int cost = patchSad(leftGray, rightGray, x, xr, y, radius);
+                    if (cost < bestCost) {
+                        if (best < 0 || std::abs(xr - best) > 1) {
+                            secondCost = bestCost;
+                        }
+                        bestCost = cost;
+                        best = xr;
+                    } else if (std::abs(xr - best) > 1 && cost < secondCost) {
+                        secondCost = cost;
+                    }
+                }
+            }
+            
+            if (best < 0 || (secondCost != std::numeric_limits<int>::max() &&
+                             bestCost >= params.uniquenessRatio * secondCost)) {
+                continue;
+            }
+            
+            // Parabolic sub-pixel refinement on the neighbouring right columns
+            float disparity = static_cast<float>(x - best);
+            if (best - 1 - radius >= 0 && best + 1 + radius < rightGray.cols) {
+                int prev = patchSad(leftGray, rightGray, x, best - 1, y, radius);
+                int next = patchSad(leftGray, rightGray, x, best + 1, y, radius);
+                int denom = prev + next - 2 * bestCost;
+                if (denom > 0) {
+                    disparity -= 0.5f * (prev - next) / static_cast<float>(denom);
+                }
+            }
+            if (disparity <= 0.0f) {
+                continue;
+            }
+            
+            cv::Vec4d h = disparityToDepth * cv::Vec4d(x, y, disparity, 1.0);
+            if (std::abs(h[3]) < 1e-12) {
+                continue;
+            }
+            
+            SparsePoint point;
+            point.pixel = cv::Point2f(static_cast<float>(x), static_cast<float>(y));
+            point.disparity = disparity;
+            point.point = cv::Vec3f(static_cast<float>(h[0] / h[3]), static_cast<float>(h[1] / h[3]),
+                                    static_cast<float>(h[2] / h[3]));
+            localPoints.push_back(point);
+        }
         
-        bm->compute(leftGray, rightGray, disparity);
+        std::lock_guard<std::mutex> lock(pointsMutex);
+        points.insert(points.end(), localPoints.begin(), localPoints.end());
+    });
+    
+    return points;
+}
+
+size_t estimateMatcherRowBytes(int algorithm, int quality, int width) {
+    cv::Ptr<cv::StereoMatcher> matcher = createMatcher(algorithm, quality);
+    size_t numDisparities = static_cast<size_t>(matcher->getNumDisparities());
+    
+    // Input planes, 16-bit disparity and the float copy
+    size_t rowBytes = static_cast<size_t>(width) * (1 + 1 + 2 + 4);
+    if (algorithm == 1) {
+        // MODE_SGBM keeps cost and aggregated cost (16-bit each) for every pixel and disparity
+        rowBytes += static_cast<size_t>(width) * numDisparities * 2 * sizeof(short);
+    } else {
+        // StereoBM only keeps sliding window sums per disparity
+        rowBytes += static_cast<size_t>(width) * numDisparities * sizeof(short);
+    }
+    return rowBytes;
+}
+
+cv::Mat computeDepthMapStriped(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight,
+                              int algorithm, int quality, size_t memoryBudgetBytes,
+                              cv::Mat* confidence, cv::Mat* residual) {
+    if (memoryBudgetBytes == 0) {
+        return computeDepthMap(rectifiedLeft, rectifiedRight, algorithm, quality, confidence, residual);
+    }
+    
+    cv::Mat leftGray, rightGray;
+    if (rectifiedLeft.channels() == 3) {
+        cv::cvtColor(rectifiedLeft, leftGray, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(rectifiedRight, rightGray, cv::COLOR_BGR2GRAY);
+    } else {
+        leftGray = rectifiedLeft;
+        rightGray = rectifiedRight;
+    }
+    
+    const int height = leftGray.rows;
+    const int blockSize = createMatcher(algorithm, quality)->getBlockSize();
+    const size_t rowBytes = estimateMatcherRowBytes(algorithm, quality, leftGray.cols);
+    
+    // Rows shared with the neighbouring bands: the matching window plus room for the
+    // SGBM path costs to settle, so the stitched core rows match a full-frame run
+    const int overlap = (algorithm == 1) ? blockSize + 32 : blockSize / 2 + 8;
+    const int minCoreRows = 32;
+    
+    // Concurrent bands are limited first by the budget, then by the worker count
+    size_t minBandBytes = rowBytes * (minCoreRows + 2 * overlap);
+    int concurrency = static_cast<int>(std::min<size_t>(std::max(1, cv::getNumThreads()),
+                                                       std::max<size_t>(1, memoryBudgetBytes / minBandBytes)));
+    size_t bandRows = memoryBudgetBytes / (static_cast<size_t>(concurrency) * rowBytes);
+    size_t overlapRows = 2 * static_cast<size_t>(overlap);
+    size_t coreBudget = (bandRows > overlapRows) ? bandRows - overlapRows : 0;
+    int coreRows = static_cast<int>(std::min<size_t>(height, std::max<size_t>(minCoreRows, coreBudget)));
+    if (memoryBudgetBytes < minBandBytes) {
+        std::cerr << "Matching memory budget below one " << minCoreRows 
+                  << "-row band, using the minimum band size" << std::endl;
     }
     
-    // Convert to proper depth map
+    const int numBands = (height + coreRows - 1) / coreRows;
+    concurrency = std::min(concurrency, numBands);
+    
+    cv::Mat disparity(leftGray.size(), CV_16S);
+    
+    // Each stripe of the parallel range is one worker running its bands in sequence
+    cv::parallel_for_(cv::Range(0, numBands), [&](const cv::Range& range) {
+        cv::Ptr<cv::StereoMatcher> matcher = createMatcher(algorithm, quality);
+        cv::Mat bandDisparity;
+        
+        for (int band = range.start; band < range.end; band++) {
+            int coreStart = band * coreRows;
+            int coreEnd = std::min(height, coreStart + coreRows);
+            int matchStart = std::max(0, coreStart - overlap);
+            int matchEnd = std::min(height, coreEnd + overlap);
+            
+            cv::Range rows(matchStart, matchEnd);
+            matcher->compute(leftGray.rowRange(rows), rightGray.rowRange(rows), bandDisparity);
+            
+            bandDisparity.rowRange(coreStart - matchStart, coreEnd - matchStart)
+                .copyTo(disparity.rowRange(coreStart, coreEnd));
+        }
+    }, concurrency);
+    
+    cv::Mat depthMap;
     disparity.convertTo(depthMap, CV_32F, 1.0/16.0);
     
+    scoreMatches(leftGray, rightGray, depthMap, confidence, residual);
     return depthMap;
 }
 
+// |L(x) - R(x - d)| for one row, R sampled with linear interpolation; NaN where d is invalid
+static void warpedResidualRow(const uchar* left, const uchar* right, const float* disparity,
+                              int width, float* leftRow, float* rightRow, float* out) {
+    for (int x = 0; x < width; x++) {
+        leftRow[x] = left[x];
+        rightRow[x] = right[x];
+    }
+    
+    const float maxX = static_cast<float>(width - 1);
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    int x = 0;
+    
+#if STEREO_SIMD_RESIDUAL
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    float laneOffsets[cv::VTraits<cv::v_float32>::max_nlanes];
+    for (int i = 0; i < lanes; i++) {
+        laneOffsets[i] = static_cast<float>(i);
+    }
+    const cv::v_float32 vOffsets = cv::vx_load(laneOffsets);
+    const cv::v_float32 vZero = cv::vx_setzero_f32();
+    const cv::v_float32 vMaxX = cv::vx_setall_f32(maxX);
+    const cv::v_float32 vInvalid = cv::vx_setall_f32(invalid);
+    const cv::v_int32 vOne = cv::vx_setall_s32(1);
+    const cv::v_int32 vLastIndex = cv::vx_setall_s32(width - 1);
+    
+    for (; x <= width - lanes; x += lanes) {
+        cv::v_float32 d = cv::vx_load(disparity + x);
+        cv::v_float32 xs = cv::v_sub(cv::v_add(cv::vx_setall_f32(static_cast<float>(x)), vOffsets), d);
+        cv::v_float32 valid = cv::v_and(cv::v_ge(d, vZero),
+                                        cv::v_and(cv::v_ge(xs, vZero), cv::v_le(xs, vMaxX)));
+        
+        // Clamp before the gather so invalid lanes still read inside the row
+        xs = cv::v_min(cv::v_max(xs, vZero), vMaxX);
+        cv::v_int32 x0 = cv::v_floor(xs);
+        cv::v_int32 x1 = cv::v_min(cv::v_add(x0, vOne), vLastIndex);
+        cv::v_float32 w = cv::v_sub(xs, cv::v_cvt_f32(x0));
+        
+        cv::v_float32 r0 = cv::v_lut(rightRow, x0);
+        cv::v_float32 r1 = cv::v_lut(rightRow, x1);
+        cv::v_float32 warped = cv::v_muladd(w, cv::v_sub(r1, r0), r0);
+        cv::v_float32 residual = cv::v_abs(cv::v_sub(cv::vx_load(leftRow + x), warped));
+        
+        cv::v_store(out + x, cv::v_select(valid, residual, vInvalid));
+    }
+#endif
+    
+    for (; x < width; x++) {
+        float d = disparity[x];
+        float xs = x - d;
+        if (!(d >= 0.0f) || xs < 0.0f || xs > maxX) {
+            out[x] = invalid;
+            continue;
+        }
+        int x0 = static_cast<int>(xs);
+        int x1 = std::min(x0 + 1, width - 1);
+        float w = xs - x0;
+        float warped = rightRow[x0] + w * (rightRow[x1] - rightRow[x0]);
+        out[x] = std::abs(leftRow[x] - warped);
+    }
+}
+
+void computeWarpedResidual(const cv::Mat& leftGray, const cv::Mat& rightGray,
+                          const cv::Mat& disparity, cv::Mat& residual) {
+    CV_Assert(leftGray.type() == CV_8UC1 && rightGray.type() == CV_8UC1 &&
+              disparity.type() == CV_32FC1 && leftGray.size() == disparity.size() &&
+              rightGray.size() == disparity.size());
+    
+    residual.create(disparity.size(), CV_32FC1);
+    const int width = disparity.cols;
+    
+    cv::parallel_for_(cv::Range(0, disparity.rows), [&](const cv::Range& range) {
+        // Per-thread row scratch that only grows, so repeated frames (StereoEngine) do not
+        // allocate once every worker has seen the frame width
+        thread_local std::vector<float> scratch;
+        if (scratch.size() < 2 * static_cast<size_t>(width)) {
+            scratch.resize(2 * static_cast<size_t>(width));
+        }
+        float* leftRow = scratch.data();
+        float* rightRow = scratch.data() + width;
+        for (int y = range.start; y < range.end; y++) {
+            warpedResidualRow(leftGray.ptr<uchar>(y), rightGray.ptr<uchar>(y), disparity.ptr<float>(y),
+                              width, leftRow, rightRow, residual.ptr<float>(y));
+        }
+    });
+}
+
+void computeMatchConfidence(const cv::Mat& leftGray, const cv::Mat& disparity,
+                           const cv::Mat& residual, cv::Mat& confidence) {
+    CV_Assert(leftGray.type() == CV_8UC1 && disparity.type() == CV_32FC1 && residual.type() == CV_32FC1 &&
+              leftGray.size() == disparity.size() && residual.size() == disparity.size());
+    
+    confidence.create(disparity.size(), CV_32FC1);
+    const int width = disparity.cols;
+    const int height = disparity.rows;
+    
+    // Scales of the three cues: photometric error (gray levels), texture (gradient) and
+    // disparity jump to the 4-neighbours (pixels)
+    const float residualScale = 8.0f;
+    const float textureScale = 8.0f;
+    const float jumpScale = 1.0f;
+    
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar* left = leftGray.ptr<uchar>(y);
+            const uchar* above = leftGray.ptr<uchar>(std::max(y - 1, 0));
+            const uchar* below = leftGray.ptr<uchar>(std::min(y + 1, height - 1));
+            const float* d = disparity.ptr<float>(y);
+            const float* dAbove = disparity.ptr<float>(std::max(y - 1, 0));
+            const float* dBelow = disparity.ptr<float>(std::min(y + 1, height - 1));
+            const float* r = residual.ptr<float>(y);
+            float* out = confidence.ptr<float>(y);
+            
+            for (int x = 0; x < width; x++) {
+                if (!(r[x] == r[x])) { // NaN: invalid or out of view
+                    out[x] = 0.0f;
+                    continue;
+                }
+                
+                int xl = std::max(x - 1, 0), xr = std::min(x + 1, width - 1);
+                float texture = std::abs(float(left[xr]) - float(left[xl])) +
+                                std::abs(float(below[x]) - float(above[x]));
+                
+                float jump = 0.0f;
+                const float neighbours[4] = {d[xl], d[xr], dAbove[x], dBelow[x]};
+                for (float n : neighbours) {
+                    if (n >= 0.0f) {
+                        jump = std::max(jump, std::abs(n - d[x]));
+                    }
+                }
+                
+                float photometric = 1.0f / (1.0f + r[x] / residualScale);
+                float textured = texture / (texture + textureScale);
+                float smooth = 1.0f / (1.0f + jump / jumpScale);
+                out[x] = photometric * textured * smooth;
+            }
+        }
+    });
+}
+
 cv::Mat computeResidualMap(const cv::Mat& leftImage, const cv::Mat& rightImage,
-                          const cv::Mat& depthMap) {
-    cv::Mat residual;
+                          const cv::Mat& depthMap, cv::Mat* residualValues) {
     cv::Mat leftGray, rightGray;
     
     // Convert to grayscale
@@ -78,22 +492,36 @@ cv::Mat computeResidualMap(const cv::Mat& leftImage, const cv::Mat& rightImage,
         cv::cvtColor(leftImage, leftGray, cv::COLOR_BGR2GRAY);
         cv::cvtColor(rightImage, rightGray, cv::COLOR_BGR2GRAY);
     } else {
-        leftGray = leftImage.clone();
-        rightGray = rightImage.clone();
+        leftGray = leftImage;
+        rightGray = rightImage;
     }
     
-    // Compute residual as absolute difference
-    cv::absdiff(leftGray, rightGray, residual);
+    // Photometric residual after warping the right view into the left one
+    cv::Mat localResidual;
+    cv::Mat& residual = residualValues ? *residualValues : localResidual;
+    computeWarpedResidual(leftGray, rightGray, depthMap, residual);
+    
+    return colorizeResidual(residual);
+}
+
+cv::Mat colorizeResidual(const cv::Mat& residual) {
+    // NaN (invalid disparity) saturates to 0 here and is blacked out after the colormap
+    cv::Mat residual8U, invalidMask;
+    residual.convertTo(residual8U, CV_8U);
+    cv::compare(residual, residual, invalidMask, cv::CMP_NE);
     
     // Apply colormap for visualization
     cv::Mat colorResidual;
-    cv::applyColorMap(residual, colorResidual, cv::COLORMAP_JET);
+    cv::applyColorMap(residual8U, colorResidual, cv::COLORMAP_JET);
+    colorResidual.setTo(cv::Scalar::all(0), invalidMask);
     
     return colorResidual;
 }
 
 bool savePointCloud(const cv::Mat& points3D, const cv::Mat& colors, 
-                   const std::string& filename, int format) {
+                   const std::string& filename, int format,
+                   const cv::Mat& confidence, float minConfidence,
+                   const cv::Mat& normals) {
     if (points3D.empty()) {
         std::cerr << "No 3D points to save" << std::endl;
         return false;
@@ -105,8 +533,29 @@ bool savePointCloud(const cv::Mat& points3D, const cv::Mat& colors,
         return false;
     }
     
+    // Grayscale inputs carry no texture, write geometry only
+    bool hasColor = !colors.empty() && colors.type() == CV_8UC3;
+    bool useConfidence = !confidence.empty() && minConfidence > 0.0f;
+    bool hasNormals = !normals.empty() && normals.type() == CV_32FC3 && normals.size() == points3D.size();
+    
+    auto isWritten = [&](int i, int j) {
+        const cv::Vec3f& point = points3D.at<cv::Vec3f>(i, j);
+        if (!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2])) {
+            return false;
+        }
+        return !useConfidence || confidence.at<float>(i, j) >= minConfidence;
+    };
+    
     if (format == 0) { // PLY format
-        int numPoints = points3D.rows * points3D.cols;
+        // The vertex count must match the points actually written
+        int numPoints = 0;
+        for (int i = 0; i < points3D.rows; i++) {
+            for (int j = 0; j < points3D.cols; j++) {
+                if (isWritten(i, j)) {
+                    numPoints++;
+                }
+            }
+        }
         
         // Write PLY header
         file << "ply" << std::endl;
@@ -115,7 +564,12 @@ bool savePointCloud(const cv::Mat& points3D, const cv::Mat& colors,
         file << "property float x" << std::endl;
         file << "property float y" << std::endl;
         file << "property float z" << std::endl;
-        if (!colors.empty()) {
+        if (hasNormals) {
+            file << "property float nx" << std::endl;
+            file << "property float ny" << std::endl;
+            file << "property float nz" << std::endl;
+        }
+        if (hasColor) {
             file << "property uchar red" << std::endl;
             file << "property uchar green" << std::endl;
             file << "property uchar blue" << std::endl;
@@ -125,16 +579,25 @@ bool savePointCloud(const cv::Mat& points3D, const cv::Mat& colors,
         // Write points
         for (int i = 0; i < points3D.rows; i++) {
             for (int j = 0; j < points3D.cols; j++) {
-                cv::Vec3f point = points3D.at<cv::Vec3f>(i, j);
-                if (std::isfinite(point[0]) && std::isfinite(point[1]) && std::isfinite(point[2])) {
+                if (isWritten(i, j)) {
+                    cv::Vec3f point = points3D.at<cv::Vec3f>(i, j);
                     file << point[0] << " " << point[1] << " " << point[2];
                     
-                    if (!colors.empty()) {
+                    if (hasNormals) {
+                        // Points without enough neighbors for a normal get a zero vector
+                        cv::Vec3f normal = normals.at<cv::Vec3f>(i, j);
+                        if (!std::isfinite(normal[0])) {
+                            normal = cv::Vec3f(0.0f, 0.0f, 0.0f);
+                        }
+                        file << " " << normal[0] << " " << normal[1] << " " << normal[2];
+                    }
+                    
+                    if (hasColor) {
                         cv::Vec3b color = colors.at<cv::Vec3b>(i, j);
                         file << " " << (int)color[2] << " " << (int)color[1] << " " << (int)color[0];
                     }
                     
-                    file << std::endl;
+                    file << '\n';
                 }
             }
         }
@@ -168,19 +631,156 @@ bool saveRectifiedImages(const cv::Mat& rectLeft, const cv::Mat& rectRight,
     return success1 && success2;
 }
 
+// Rectifies a window of the frame: shifting the principal points of P1/P2 maps window
+// pixel (u, v) to rectified pixel (u + window.x, v + window.y)
+static void rectifyWindow(const StereoCalibration::StereoCalibrationResult& calibData,
+                          const cv::Mat& leftImage, const cv::Mat& rightImage, const cv::Rect& window,
+                          cv::Mat& rectifiedLeft, cv::Mat& rectifiedRight) {
+    cv::Mat P1 = calibData.P1.clone(), P2 = calibData.P2.clone();
+    P1.at<double>(0, 2) -= window.x;
+    P1.at<double>(1, 2) -= window.y;
+    P2.at<double>(0, 2) -= window.x;
+    P2.at<double>(1, 2) -= window.y;
+    
+    cv::Mat map1x, map1y, map2x, map2y;
+    cv::initUndistortRectifyMap(calibData.cameraMatrix1, calibData.distCoeffs1,
+                               calibData.R1, P1, window.size(),
+                               CV_16SC2, map1x, map1y);
+    cv::initUndistortRectifyMap(calibData.cameraMatrix2, calibData.distCoeffs2,
+                               calibData.R2, P2, window.size(),
+                               CV_16SC2, map2x, map2y);
+    
+    cv::remap(leftImage, rectifiedLeft, map1x, map1y, cv::INTER_LINEAR);
+    cv::remap(rightImage, rectifiedRight, map2x, map2y, cv::INTER_LINEAR);
+}
+
+// Controllers for ReconstructionParams::timeBudgetMs, one per profile file and frame size so
+// that a different profile or resolution never reuses another's timings. Each host profile
+// is measured once, on the first full-frame rectified pair, unless a saved profile is available.
+static std::mutex budgetMutex;
+static std::map<std::pair<std::string, std::pair<int, int>>,
+                std::unique_ptr<LatencyBudget::BudgetController>> budgetControllers;
+
+static MatcherConfig selectBudgetConfig(const ReconstructionParams& params,
+                                        const StereoCalibration::StereoCalibrationResult& calibData,
+                                        const cv::Mat& leftImage, const cv::Mat& rightImage,
+                                        LatencyBudget::BudgetController*& controller) {
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    
+    auto key = std::make_pair(params.latencyProfileFile, std::make_pair(leftImage.cols, leftImage.rows));
+    std::unique_ptr<LatencyBudget::BudgetController>& entry = budgetControllers[key];
+    if (!entry) {
+        LatencyBudget::HostProfile profile;
+        bool loaded = !params.latencyProfileFile.empty() &&
+                      LatencyBudget::loadProfile(params.latencyProfileFile, profile);
+        if (loaded && profile.imageSize != leftImage.size()) {
+            std::cout << "Latency profile " << params.latencyProfileFile << " was measured at "
+                      << profile.imageSize << "; times are scaled to " << leftImage.size() << std::endl;
+        }
+        if (!loaded) {
+            std::cout << "Profiling matcher configurations for the latency budget..." << std::endl;
+            cv::Mat rectifiedLeft, rectifiedRight;
+            rectifyWindow(calibData, leftImage, rightImage, cv::Rect(cv::Point(0, 0), leftImage.size()),
+                          rectifiedLeft, rectifiedRight);
+            profile = LatencyBudget::profileHost(rectifiedLeft, rectifiedRight);
+            if (!params.latencyProfileFile.empty()) {
+                LatencyBudget::saveProfile(profile, params.latencyProfileFile);
+            }
+        }
+        entry.reset(new LatencyBudget::BudgetController(profile, params.timeBudgetMs));
+    } else {
+        entry->setBudget(params.timeBudgetMs);
+    }
+    
+    controller = entry.get();
+    return controller->currentConfig();
+}
+
+static void reportBudgetTiming(LatencyBudget::BudgetController* controller, double milliseconds,
+                               cv::Size imageSize) {
+    std::lock_guard<std::mutex> lock(budgetMutex);
+    if (controller) {
+        controller->reportTiming(milliseconds, imageSize);
+    }
+}
+
+// Region of the rectified left image to reconstruct; the full frame when the mode does not apply.
+// params.roi is in full-resolution pixels like roi1, so it shrinks with the decode scale too.
+static cv::Rect reconstructionRegion(const ReconstructionParams& params,
+                                     const StereoCalibration::StereoCalibrationResult& calibData,
+                                     cv::Size imageSize) {
+    cv::Rect frame(cv::Point(0, 0), imageSize);
+    cv::Rect region = frame;
+    if (params.roiMode == 1) {
+        region = calibData.roi1 & frame;
+    } else if (params.roiMode == 2) {
+        int reduction = std::max(1, params.decodeScale);
+        cv::Rect scaled(params.roi.x / reduction, params.roi.y / reduction,
+                        params.roi.width / reduction, params.roi.height / reduction);
+        region = scaled & frame;
+    }
+    return region.area() > 0 ? region : frame;
+}
+
+// Region grown by what the matcher reads around it: the disparity search range to the left
+// and half a block on every side, in full-resolution pixels. Both views are rectified over
+// this same window so that disparities are unchanged.
+static cv::Rect matchingWindow(const cv::Rect& region, cv::Size imageSize, const MatcherConfig& config) {
+    int halfBlock = config.blockSize * std::max(1, config.downscale) / 2;
+    cv::Rect window(region.x - config.numDisparities - halfBlock, region.y - halfBlock,
+                    region.width + config.numDisparities + 2 * halfBlock, region.height + 2 * halfBlock);
+    return window & cv::Rect(cv::Point(0, 0), imageSize);
+}
+
 ReconstructionOutput performStereoReconstruction(const ReconstructionParams& params) {
     ReconstructionOutput output;
     output.success = false;
     
+    // Wall time (and optionally memory use) of each stage since the previous mark
+    MemoryProfile::StageTracker memoryTracker(params.trackMemory);
+    auto stageStart = std::chrono::high_resolution_clock::now();
+    auto markStage = [&](const char* stage) {
+        auto now = std::chrono::high_resolution_clock::now();
+        output.stageTimings.push_back({stage, std::chrono::duration<double, std::milli>(now - stageStart).count()});
+        memoryTracker.mark(stage);
+        stageStart = now;
+    };
+    
+    // Only these reductions have a reduced decode; any other value would decode at full size
+    // while the calibration is scaled down
+    if (params.decodeScale != 1 && params.decodeScale != 2 && params.decodeScale != 4 &&
+        params.decodeScale != 8) {
+        std::cerr << "Unsupported decode scale " << params.decodeScale << " (use 1, 2, 4 or 8)" << std::endl;
+        return output;
+    }
+    
     try {
-        // Load images
-        cv::Mat leftImage = cv::imread(params.leftImagePath);
-        cv::Mat rightImage = cv::imread(params.rightImagePath);
+        // Repeat requests are answered from the cache by hashing the encoded inputs, without
+        // decoding or matching
+        uint64_t cacheKey = 0;
+        bool useCache = !params.resultCacheFolder.empty() && ResultCache::computeKey(params, cacheKey);
+        if (useCache) {
+            ResultCache::CachedResult cached;
+            if (ResultCache::lookup(params.resultCacheFolder, cacheKey, cached)) {
+                // Stored timings describe the original run; the cache stage is this lookup
+                ResultCache::expand(cached, output);
+                markStage("cache");
+                output.stageMemory = memoryTracker.stages();
+                output.success = true;
+                return output;
+            }
+        }
+        
+        // Load images; the color planes are only decoded when colors are exported
+        bool grayscale = !params.useColorTexture;
+        cv::Mat leftImage = ImageIO::loadImage(params.leftImagePath, grayscale, params.decodeScale);
+        cv::Mat rightImage = ImageIO::loadImage(params.rightImagePath, grayscale, params.decodeScale);
         
         if (leftImage.empty() || rightImage.empty()) {
             std::cerr << "Cannot load input images" << std::endl;
             return output;
         }
+        markStage("load");
         
         // Load calibration data
         StereoCalibration::StereoCalibrationResult calibData;
@@ -188,30 +788,96 @@ ReconstructionOutput performStereoReconstruction(const ReconstructionParams& par
             std::cerr << "Cannot load calibration data" << std::endl;
             return output;
         }
+        calibData = StereoCalibration::scaleCalibration(calibData, params.decodeScale);
+        markStage("calibration");
         
-        // Create rectification maps
-        cv::Mat map1x, map1y, map2x, map2y;
-        cv::initUndistortRectifyMap(calibData.cameraMatrix1, calibData.distCoeffs1,
-                                   calibData.R1, calibData.P1, leftImage.size(),
-                                   CV_16SC2, map1x, map1y);
-        cv::initUndistortRectifyMap(calibData.cameraMatrix2, calibData.distCoeffs2,
-                                   calibData.R2, calibData.P2, rightImage.size(),
-                                   CV_16SC2, map2x, map2y);
+        // The matcher configuration sets the margin around the region, so it is fixed first:
+        // within a time budget, or with the fixed quality mapping
+        bool budgeted = params.timeBudgetMs > 0.0;
+        LatencyBudget::BudgetController* budgetController = nullptr;
+        MatcherConfig matcherConfig = budgeted
+            ? selectBudgetConfig(params, calibData, leftImage, rightImage, budgetController)
+            : matcherConfigForQuality(params.algorithm, params.quality);
         
-        // Rectify images
-        cv::remap(leftImage, output.rectifiedLeft, map1x, map1y, cv::INTER_LINEAR);
-        cv::remap(rightImage, output.rectifiedRight, map2x, map2y, cv::INTER_LINEAR);
+        // Only the region plus the matcher's margin is rectified and matched
+        cv::Rect region = reconstructionRegion(params, calibData, leftImage.size());
+        cv::Rect window = matchingWindow(region, leftImage.size(), matcherConfig);
+        output.roi = region;
         
-        // Compute depth map
-        output.depthMap = computeDepthMap(output.rectifiedLeft, output.rectifiedRight, 
-                                         params.algorithm, params.quality);
+        rectifyWindow(calibData, leftImage, rightImage, window, output.rectifiedLeft, output.rectifiedRight);
+        markStage("rectify");
         
-        // Compute 3D points
-        cv::reprojectImageTo3D(output.depthMap, output.pointCloud3D, calibData.Q);
+        // Compute depth map with the chosen configuration, in overlapping bands when memory
+        // is bounded
+        if (budgeted) {
+            auto matchStart = std::chrono::high_resolution_clock::now();
+            output.depthMap = computeDepthMap(output.rectifiedLeft, output.rectifiedRight,
+                                             matcherConfig, &output.confidenceMap, &output.residualValues);
+            auto matchEnd = std::chrono::high_resolution_clock::now();
+            
+            reportBudgetTiming(budgetController,
+                               std::chrono::duration<double, std::milli>(matchEnd - matchStart).count(),
+                               output.rectifiedLeft.size());
+        } else if (params.matchMemoryBudget > 0) {
+            output.depthMap = computeDepthMapStriped(output.rectifiedLeft, output.rectifiedRight,
+                                                    params.algorithm, params.quality,
+                                                    params.matchMemoryBudget, &output.confidenceMap,
+                                                    &output.residualValues);
+        } else {
+            output.depthMap = computeDepthMap(output.rectifiedLeft, output.rectifiedRight, 
+                                             matcherConfig, &output.confidenceMap, &output.residualValues);
+        }
         
-        // Compute residual map
-        output.residualMap = computeResidualMap(output.rectifiedLeft, output.rectifiedRight, 
-                                               output.depthMap);
+        // Drop the matching margin
+        if (window != region) {
+            cv::Rect crop(region.tl() - window.tl(), region.size());
+            output.rectifiedLeft = output.rectifiedLeft(crop).clone();
+            output.rectifiedRight = output.rectifiedRight(crop).clone();
+            output.depthMap = output.depthMap(crop).clone();
+            output.confidenceMap = output.confidenceMap(crop).clone();
+            output.residualValues = output.residualValues(crop).clone();
+        }
+        markStage("match");
+        
+        // Compute 3D points; Q takes full-frame pixel coordinates, so offset it by the region
+        cv::Matx44d regionOffset(1, 0, 0, region.x,
+                                 0, 1, 0, region.y,
+                                 0, 0, 1, 0,
+                                 0, 0, 0, 1);
+        cv::Mat regionQ = cv::Mat(cv::Matx44d(calibData.Q) * regionOffset);
+        cv::reprojectImageTo3D(output.depthMap, output.pointCloud3D, regionQ);
+        markStage("reproject");
+        
+        if (params.removeOutliers) {
+            PointCloudFilter::removeStatisticalOutliers(output.pointCloud3D, params.outlierParams, output.depthMap);
+            markStage("outliers");
+        }
+        
+        if (params.computeNormals) {
+            // Invalid disparities reproject to finite points; keep only matched pixels
+            PointCloudNormals::computeNormals(output.pointCloud3D, output.normals, params.normalRadius,
+                                              output.depthMap > 0);
+            markStage("normals");
+        }
+        
+        if (params.extractPlanes) {
+            output.planes = PlaneSegmentation::extractPlanes(output.pointCloud3D, params.planeParams,
+                                                             output.depthMap > 0);
+            markStage("planes");
+        }
+        
+        // Residual map from the residual the confidence was scored from
+        output.residualMap = colorizeResidual(output.residualValues);
+        markStage("residual");
+        
+        if (useCache) {
+            ResultCache::CacheLimits limits;
+            limits.maxBytes = params.resultCacheMaxBytes;
+            limits.maxEntries = params.resultCacheMaxEntries;
+            ResultCache::store(params.resultCacheFolder, cacheKey, output, limits);
+            markStage("cache");
+        }
+        output.stageMemory = memoryTracker.stages();
         
         output.success = true;
         
@@ -247,42 +913,22 @@ bool reconstruct3DModel(const std::string& leftImagePath, const std::string& rig
         return false;
     }
     
-    // Create output directory
-    fs::create_directories(outputFolder);
-    
-    // Save depth map
-    std::string depthPath = outputFolder + "/depth_map.jpg";
-    if (!saveDepthMap(result.depthMap, depthPath)) {
-        std::cerr << "Failed to save depth map" << std::endl;
-    } else {
-        std::cout << "Depth map saved to: " << depthPath << std::endl;
-    }
-    
-    // Save rectified images
-    if (!saveRectifiedImages(result.rectifiedLeft, result.rectifiedRight, outputFolder)) {
-        std::cerr << "Failed to save rectified images" << std::endl;
-    } else {
-        std::cout << "Rectified images saved to: " << outputFolder << std::endl;
-    }
-    
-    // Save residual map
-    std::string residualPath = outputFolder + "/residual_map.jpg";
-    if (!cv::imwrite(residualPath, result.residualMap)) {
-        std::cerr << "Failed to save residual map" << std::endl;
-    } else {
-        std::cout << "Residual map saved to: " << residualPath << std::endl;
-    }
+    // Encode and write all artifacts in parallel on the shared writer pool
+    OutputWriter::ArtifactFutures futures = OutputWriter::writeReconstructionOutputs(
+        OutputWriter::sharedWriter(), result, outputFolder, outputFormat,
+        useColorTexture, params.minConfidence);
     
-    // Save point cloud
-    std::string pointCloudPath = outputFolder + "/point_cloud.ply";
-    cv::Mat colors = result.rectifiedLeft; // Use left image for colors
-    if (!savePointCloud(result.pointCloud3D, colors, pointCloudPath, outputFormat)) {
-        std::cerr << "Failed to save point cloud" << std::endl;
-    } else {
-        std::cout << "Point cloud saved to: " << pointCloudPath << std::endl;
+    // collect() reports each failed artifact; any failure fails the reconstruction
+    bool allWritten = true;
+    for (const auto& status : OutputWriter::collect(futures)) {
+        if (status.success) {
+            std::cout << "Saved: " << status.path << std::endl;
+        } else {
+            allWritten = false;
+        }
     }
     
-    return true;
+    return allWritten;
 }
 
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
+#include "memory_profile.h"
+#include "point_cloud_filter.h"
+#include "plane_segmentation.h"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
 
 namespace StereoReconstruction {
     struct ReconstructionParams {
@@ -14,19 +18,75 @@ namespace StereoReconstruction {
         bool useColorTexture;
         float maxDepth;
         float minDepth;
-        int algorithm; // 0=BM, 1=SGBM, 2=GC
+        int algorithm; // 0=BM, 1=SGBM, 2=GC, 3=SAD block matcher
         int postProcessing; // 0=None, 1=Median, 2=Bilateral
+        int decodeScale = 1; // 1, 2, 4, 8: reduced (DCT-domain) decode for previews; other values are rejected
+        size_t matchMemoryBudget = 0; // bytes for striped matching, 0 = whole frame at once
+        float minConfidence = 0.0f; // points below this match confidence are not exported
+        double timeBudgetMs = 0.0; // per-pair matching budget, > 0 overrides quality/algorithm
+        std::string latencyProfileFile; // host profile cache for the budget mode
+        bool trackMemory = false; // record allocations and RSS per stage in stageMemory
+        bool removeOutliers = false; // drop flying pixels and invalid-disparity points before export
+        PointCloudFilter::OutlierParams outlierParams;
+        bool computeNormals = false; // per-point normals, exported as nx ny nz
+        int normalRadius = 3;        // normal window of (2 * normalRadius + 1)^2 pixels
+        bool extractPlanes = false;  // dominant planes with inlier masks in ReconstructionOutput::planes
+        PlaneSegmentation::PlaneParams planeParams;
+        int roiMode = 1;  // 0=full frame, 1=calibration valid ROI (roi1), 2=roi below
+        cv::Rect roi;     // rectified left-image region for roiMode 2, in full-resolution pixels
+        std::string resultCacheFolder;                   // content-addressed result cache, empty = off
+        size_t resultCacheMaxBytes = size_t(1) << 30;    // LRU limits of that cache, 0 = unlimited
+        size_t resultCacheMaxEntries = 0;
+    };
+    
+    // Explicit matcher setup; quality levels map onto it through matcherConfigForQuality
+    struct MatcherConfig {
+        int algorithm;      // 0=BM, 1=SGBM, 3=SAD block matcher
+        int blockSize;
+        int numDisparities; // full-resolution pixels, multiple of 16
+        int downscale;      // 1, 2, 4: match a reduced pair and upsample the disparity
+    };
+    
+    // Sparse preview: FAST corners matched along the epipolar row instead of dense matching
+    struct SparseMatchParams {
+        int fastThreshold = 20;
+        int maxFeatures = 3000;       // strongest left-image corners kept
+        int patchSize = 7;            // odd SAD patch edge
+        int numDisparities = 96;
+        int rowTolerance = 1;         // right corners this many rows off the left row still match
+        float uniquenessRatio = 0.8f; // best cost must be below this fraction of the runner-up
+    };
+    
+    struct SparsePoint {
+        cv::Point2f pixel;  // rectified left image
+        float disparity;
+        cv::Vec3f point;    // triangulated with Q
+    };
+    
+    struct StageTiming {
+        std::string stage;
+        double milliseconds;
     };
     
     struct ReconstructionOutput {
         cv::Mat depthMap;
         cv::Mat residualMap;
+        cv::Mat residualValues; // CV_32F photometric residual, NaN where disparity is invalid
         cv::Mat rectifiedLeft;
         cv::Mat rectifiedRight;
         cv::Mat pointCloud3D;
+        cv::Mat confidenceMap; // CV_32F in [0, 1], 0 where disparity is invalid
+        cv::Mat normals;       // CV_32FC3, only with computeNormals
+        std::vector<PlaneSegmentation::Plane> planes; // only with extractPlanes
+        cv::Rect roi;          // region of the rectified frame covered by the maps above
+        bool fromCache = false; // restored from the result cache: no rectified or residual images
+        cv::Mat pointColors;   // CV_8UC3 cloud colors of a cached result, in place of rectifiedLeft
+        std::vector<StageTiming> stageTimings; // load, calibration, rectify, match, reproject, [outliers, normals, planes,] residual
+        std::vector<MemoryProfile::StageMemory> stageMemory; // same stages, only with trackMemory
         bool success;
     };
     
+    // Reconstructs and writes every artifact; false when reconstruction or any write fails
     bool reconstruct3DModel(const std::string& leftImagePath, const std::string& rightImagePath,
                            const std::string& outputFolder, const std::string& calibrationFile,
                            int outputFormat, int meshGeneration, int quality, bool useColorTexture,
@@ -34,14 +94,62 @@ namespace StereoReconstruction {
     
     ReconstructionOutput performStereoReconstruction(const ReconstructionParams& params);
     
+    MatcherConfig matcherConfigForQuality(int algorithm, int quality);
+    
+    cv::Ptr<cv::StereoMatcher> createMatcher(const MatcherConfig& config);
+    
+    // Matcher configured for the given algorithm and quality level (1-5)
+    cv::Ptr<cv::StereoMatcher> createMatcher(int algorithm, int quality);
+    
+    cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight,
+                           const MatcherConfig& config, cv::Mat* confidence = nullptr,
+                           cv::Mat* residual = nullptr);
+    
+    // confidence optionally receives the per-pixel match confidence (see computeMatchConfidence)
+    // and residual the warped residual it is scored from (see computeWarpedResidual), so that
+    // the residual map does not warp the pair a second time
     cv::Mat computeDepthMap(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight, 
-                           int algorithm, int quality);
+                           int algorithm, int quality, cv::Mat* confidence = nullptr,
+                           cv::Mat* residual = nullptr);
+    
+    // Sparse counterpart of computeDepthMap for near-instant previews on a rectified gray pair
+    std::vector<SparsePoint> computeSparseDepth(const cv::Mat& leftGray, const cv::Mat& rightGray,
+                                                const cv::Mat& Q,
+                                                const SparseMatchParams& params = SparseMatchParams());
+    
+    // Approximate matcher working set per image row, used to size bands for a memory budget
+    size_t estimateMatcherRowBytes(int algorithm, int quality, int width);
     
+    // Match horizontal bands with vertical overlap concurrently so that peak memory follows
+    // the band size; the core rows of each band are stitched into one disparity map
+    cv::Mat computeDepthMapStriped(const cv::Mat& rectifiedLeft, const cv::Mat& rectifiedRight,
+                                  int algorithm, int quality, size_t memoryBudgetBytes,
+                                  cv::Mat* confidence = nullptr, cv::Mat* residual = nullptr);
+    
+    // Match confidence in [0, 1] from the warped photometric residual (computeWarpedResidual
+    // output), local texture and disparity jumps to the 4-neighbours; one row-parallel pass
+    // right after matching
+    void computeMatchConfidence(const cv::Mat& leftGray, const cv::Mat& disparity,
+                               const cv::Mat& residual, cv::Mat& confidence);
+    
+    // Warp the right view into the left one with the disparity (SIMD, row-parallel) and
+    // store |L - R_warped| as CV_32F with NaN for invalid or out-of-view disparities
+    void computeWarpedResidual(const cv::Mat& leftGray, const cv::Mat& rightGray,
+                              const cv::Mat& disparity, cv::Mat& residual);
+    
+    // Colorized warped residual; residualValues optionally receives the float residual
     cv::Mat computeResidualMap(const cv::Mat& leftImage, const cv::Mat& rightImage,
-                              const cv::Mat& depthMap);
+                              const cv::Mat& depthMap, cv::Mat* residualValues = nullptr);
+    
+    // JET colorization of a computeWarpedResidual result, invalid pixels black
+    cv::Mat colorizeResidual(const cv::Mat& residual);
     
+    // Points whose confidence is below minConfidence are skipped when a confidence map is given;
+    // a normal map adds nx ny nz properties
     bool savePointCloud(const cv::Mat& points3D, const cv::Mat& colors, 
-                       const std::string& filename, int format);
+                       const std::string& filename, int format,
+                       const cv::Mat& confidence = cv::Mat(), float minConfidence = 0.0f,
+                       const cv::Mat& normals = cv::Mat());
     
     bool saveDepthMap(const cv::Mat& depthMap, const std::string& filename);
     
@@ -0,0 +1,129 @@
+#include "task_pool.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <iostream>
+
+namespace Threading {
+
+TaskPool::TaskPool(int threadCount) : TaskPool(threadCount, std::vector<std::vector<int>>()) {}
+
+TaskPool::TaskPool(int threadCount, const std::vector<std::vector<int>>& affinity)
+    : active(0), stopping(false) {
+    int count = std::max(1, threadCount);
+    for (int i = 0; i < count; i++) {
+        std::vector<int> cpus = affinity.empty() ? std::vector<int>() : affinity[i % affinity.size()];
+        workers.emplace_back([this, cpus] {
+            if (!cpus.empty()) {
+                pinCurrentThread(cpus);
+            }
+            workerLoop();
+        });
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void TaskPool::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void TaskPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && active == 0; });
+}
+
+void TaskPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            // Remaining tasks are drained before the pool shuts down
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            active++;
+        }
+        
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Error in pool task: " << e.what() << std::endl;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            if (tasks.empty() && active == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+}
+
+TaskGroup::TaskGroup(TaskPool& pool) : pool(pool), pending(0) {}
+
+TaskGroup::~TaskGroup() {
+    wait();
+}
+
+void TaskGroup::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+    }
+    
+    pool.post([this, task] {
+        // Counted as finished even when the task throws (the pool logs the error)
+        struct Finish {
+            TaskGroup* group;
+            ~Finish() { group->finished(); }
+        } finish{this};
+        task();
+    });
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+}
+
+void TaskGroup::finished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pending == 0) {
+        done.notify_all();
+    }
+}
+
+InFlightLimit::InFlightLimit(int limit) : available(std::max(1, limit)) {}
+
+void InFlightLimit::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this] { return available > 0; });
+    available--;
+}
+
+void InFlightLimit::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        available++;
+    }
+    released.notify_one();
+}
+
+}
\ No newline at end of file
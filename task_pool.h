@@ -0,0 +1,79 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Threading {
+    // Fixed-size worker pool for pipeline stages that run beside OpenCV's own parallel_for_
+    class TaskPool {
+    public:
+        explicit TaskPool(int threadCount);
+        
+        // Worker i is pinned to affinity[i % affinity.size()]; see Threading::workerAffinity
+        TaskPool(int threadCount, const std::vector<std::vector<int>>& affinity);
+        ~TaskPool();
+        
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+        
+        void post(std::function<void()> task);
+        
+        // Blocks until every posted task has finished
+        void waitIdle();
+        
+        int threadCount() const { return static_cast<int>(workers.size()); }
+        
+    private:
+        void workerLoop();
+        
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::condition_variable idle;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> workers;
+        size_t active;
+        bool stopping;
+    };
+    
+    // Tasks one caller posts to a shared pool, so it can wait for those without waiting for
+    // everyone else's. Must not be waited on from a worker of the same pool.
+    class TaskGroup {
+    public:
+        explicit TaskGroup(TaskPool& pool);
+        ~TaskGroup(); // waits for the group
+        
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        
+        void post(std::function<void()> task);
+        
+        // Blocks until every task posted through this group has finished
+        void wait();
+        
+    private:
+        void finished();
+        
+        TaskPool& pool;
+        std::mutex mutex;
+        std::condition_variable done;
+        int pending;
+    };
+    
+    // Counting semaphore that bounds the items held in memory between pipeline stages
+    class InFlightLimit {
+    public:
+        explicit InFlightLimit(int limit);
+        
+        // Blocks until a slot is free
+        void acquire();
+        void release();
+        
+    private:
+        std::mutex mutex;
+        std::condition_variable released;
+        int available;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "thread_config.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Threading {
+
+namespace {
+
+std::mutex configMutex;
+bool configured = false;
+ThreadingConfig activeConfig;
+std::unique_ptr<TaskPool> pool;
+
+#ifdef __linux__
+// Parses a sysfs cpulist such as "0-3,8-11"
+std::vector<int> parseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream stream(text);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // Trailing newline or empty entry
+        }
+    }
+    return cpus;
+}
+#endif
+
+ThreadingConfig resolve(const ThreadingConfig& requested) {
+    ThreadingConfig config = requested;
+    if (config.cpus.empty()) {
+        config.cpus = availableCpus();
+    }
+    
+    int cores = std::max(1, static_cast<int>(config.cpus.size()));
+    if (config.totalThreads <= 0) {
+        config.totalThreads = cores;
+    }
+    if (config.poolThreads <= 0) {
+        config.poolThreads = std::max(1, config.totalThreads / 4);
+    }
+    config.jobThreads = std::max(1, config.jobThreads);
+    if (config.opencvThreads <= 0) {
+        // One job worker's matching stands in for the calling thread's
+        config.opencvThreads = std::max(1, config.totalThreads - config.poolThreads - (config.jobThreads - 1));
+    }
+    return config;
+}
+
+// Cores OpenCV may use: with per-core pinning the pool workers own the last poolThreads cores
+std::vector<int> opencvCpus(const ThreadingConfig& config) {
+    if (config.affinity != AFFINITY_CORES || config.cpus.size() <= static_cast<size_t>(config.poolThreads)) {
+        return config.cpus;
+    }
+    return std::vector<int>(config.cpus.begin(), config.cpus.end() - config.poolThreads);
+}
+
+std::vector<std::vector<int>> affinityFor(const ThreadingConfig& config, int threadCount) {
+    std::vector<std::vector<int>> affinity;
+    if (config.affinity == AFFINITY_NONE || config.cpus.empty() || threadCount <= 0) {
+        return affinity;
+    }
+    
+    if (config.affinity == AFFINITY_NUMA) {
+        affinity.assign(threadCount, config.cpus);
+        return affinity;
+    }
+    
+    // Round-robin over the cores left to the pool, counting from the end of the partition
+    int poolCores = std::min(static_cast<int>(config.cpus.size()), std::max(1, config.poolThreads));
+    for (int i = 0; i < threadCount; i++) {
+        affinity.push_back({config.cpus[config.cpus.size() - 1 - i % poolCores]});
+    }
+    return affinity;
+}
+
+void applyOpencv(const ThreadingConfig& config) {
+    if (config.affinity != AFFINITY_NONE && !pinCurrentThread(opencvCpus(config))) {
+        std::cerr << "Thread pinning is not supported on this platform" << std::endl;
+    }
+    cv::setNumThreads(config.opencvThreads);
+}
+
+} // namespace
+
+// Affinity of the process as started; queried once because pinning the calling thread
+// changes what the OS reports for it afterwards
+static std::vector<int> queryProcessCpus() {
+    std::vector<int> cpus;
+#ifdef _WIN32
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); cpu++) {
+            if (processMask & (static_cast<DWORD_PTR>(1) << cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < count; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> availableCpus() {
+    static const std::vector<int> processCpus = queryProcessCpus();
+    return processCpus;
+}
+
+std::vector<std::vector<int>> numaNodes() {
+    std::vector<int> available = availableCpus();
+    std::set<int> allowed(available.begin(), available.end());
+    std::vector<std::vector<int>> nodes;
+    
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode)) {
+        for (ULONG node = 0; node <= highestNode; node++) {
+            ULONGLONG mask = 0;
+            std::vector<int> cpus;
+            if (GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask)) {
+                for (int cpu = 0; cpu < 64; cpu++) {
+                    if ((mask & (1ULL << cpu)) && allowed.count(cpu)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+            if (!cpus.empty()) {
+                nodes.push_back(cpus);
+            }
+        }
+    }
+#elif defined(__linux__)
+    for (int node = 0; ; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open()) {
+            break;
+        }
+        std::string text;
+        std::getline(file, text);
+        
+        std::vector<int> cpus;
+        for (int cpu : parseCpuList(text)) {
+            if (allowed.count(cpu)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(cpus);
+        }
+    }
+#endif
+    
+    if (nodes.empty()) {
+        nodes.push_back(available);
+    }
+    return nodes;
+}
+
+std::vector<std::vector<int>> partitionCpus(int partitions, AffinityMode mode) {
+    std::vector<int> cpus = availableCpus();
+    partitions = std::max(1, std::min(partitions, static_cast<int>(cpus.size())));
+    std::vector<std::vector<int>> result(partitions);
+    
+    if (mode == AFFINITY_NUMA) {
+        std::vector<std::vector<int>> nodes = numaNodes();
+        if (static_cast<int>(nodes.size()) >= partitions) {
+            for (size_t node = 0; node < nodes.size(); node++) {
+                auto& target = result[node % partitions];
+                target.insert(target.end(), nodes[node].begin(), nodes[node].end());
+            }
+            return result;
+        }
+        
+        // Node-major order so the contiguous split below crosses as few nodes as possible
+        cpus.clear();
+        for (const auto& node : nodes) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+    }
+    
+    for (int p = 0; p < partitions; p++) {
+        size_t begin = cpus.size() * p / partitions;
+        size_t end = cpus.size() * (p + 1) / partitions;
+        result[p].assign(cpus.begin() + begin, cpus.begin() + end);
+    }
+    return result;
+}
+
+ThreadingConfig partitionConfig(int index, int count, AffinityMode mode) {
+    std::vector<std::vector<int>> partitions = partitionCpus(count, mode);
+    
+    ThreadingConfig config;
+    config.cpus = partitions[std::max(0, index) % partitions.size()];
+    config.affinity = mode;
+    return config;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    std::vector<int> mask = cpus.empty() ? availableCpus() : cpus;
+#ifdef _WIN32
+    DWORD_PTR bits = 0;
+    for (int cpu : mask) {
+        if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+            bits |= static_cast<DWORD_PTR>(1) << cpu;
+        }
+    }
+    return bits != 0 && SetThreadAffinityMask(GetCurrentThread(), bits) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : mask) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+void configure(const ThreadingConfig& config) {
+    std::lock_guard<std::mutex> lock(configMutex);
+    ThreadingConfig resolved = resolve(config);
+    
+    if (pool && pool->threadCount() != resolved.poolThreads) {
+        std::cerr << "Shared task pool already running with " << pool->threadCount()
+                  << " threads; only OpenCV's thread count is changed" << std::endl;
+        resolved.poolThreads = pool->threadCount();
+    }
+    
+    activeConfig = resolved;
+    configured = true;
+    applyOpencv(activeConfig);
+    
+    std::cout << "Threading: " << activeConfig.cpus.size() << " cores, " << activeConfig.opencvThreads
+              << " OpenCV threads, " << activeConfig.poolThreads << " pool threads, "
+              << activeConfig.jobThreads << " job threads" << std::endl;
+}
+
+ThreadingConfig currentConfig() {
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (!configured) {
+        // Programs that never called configure keep OpenCV's own thread count and placement
+        activeConfig = resolve(ThreadingConfig());
+        activeConfig.opencvThreads = cv::getNumThreads();
+        configured = true;
+    }
+    return activeConfig;
+}
+
+std::vector<std::vector<int>> workerAffinity(int threadCount) {
+    return affinityFor(currentConfig(), threadCount);
+}
+
+TaskPool& sharedPool() {
+    ThreadingConfig config = currentConfig();
+    
+    std::lock_guard<std::mutex> lock(configMutex);
+    if (!pool) {
+        pool.reset(new TaskPool(config.poolThreads, affinityFor(config, config.poolThreads)));
+    }
+    return *pool;
+}
+
+}
\ No newline at end of file
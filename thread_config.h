@@ -0,0 +1,58 @@
+#pragma once
+#include "task_pool.h"
+#include <vector>
+
+namespace Threading {
+    enum AffinityMode {
+        AFFINITY_NONE = 0,  // leave placement to the OS scheduler
+        AFFINITY_CORES = 1, // pool workers get one core each, OpenCV the remaining cores
+        AFFINITY_NUMA = 2   // every thread may run on any core of its partition (whole nodes)
+    };
+    
+    // Process-wide split of one core partition between OpenCV's parallel_for_, the shared
+    // task pool and the asynchronous job workers, so together they never add up to more
+    // threads than cores. Pipeline stages post to sharedPool() instead of starting their own.
+    struct ThreadingConfig {
+        std::vector<int> cpus;       // cores of this partition, empty = all cores available to the process
+        int totalThreads = 0;        // 0 = cpus.size()
+        int poolThreads = 0;         // shared task pool (encoding, decoding); 0 = a quarter of totalThreads
+        int jobThreads = 1;          // AsyncReconstruction::Scheduler workers; each runs its own matching,
+                                     // so all but one come out of opencvThreads
+        int opencvThreads = 0;       // cv::setNumThreads; 0 = totalThreads - poolThreads - (jobThreads - 1)
+        AffinityMode affinity = AFFINITY_NONE;
+    };
+    
+    // Cores this process may run on, in ascending order
+    std::vector<int> availableCpus();
+    
+    // Cores of each NUMA node restricted to availableCpus(); one node when the topology is unknown
+    std::vector<std::vector<int>> numaNodes();
+    
+    // Disjoint core sets for independent engines or processes. NUMA mode hands out whole nodes
+    // when there are at least as many nodes as partitions and otherwise keeps each partition
+    // on as few nodes as possible.
+    std::vector<std::vector<int>> partitionCpus(int partitions, AffinityMode mode = AFFINITY_CORES);
+    
+    // Configuration for partition index of count, e.g. one of several batch processes
+    ThreadingConfig partitionConfig(int index, int count, AffinityMode mode = AFFINITY_CORES);
+    
+    // Empty cpus clears the pinning; false when the platform does not support it
+    bool pinCurrentThread(const std::vector<int>& cpus);
+    
+    // Resolves the defaults, pins the calling thread to OpenCV's share of the cores and sets
+    // cv::setNumThreads. On Linux OpenCV's workers inherit that pinning when they start, so call
+    // this before the first parallel_for_. The shared pool is sized here as well and cannot be
+    // resized once created; later calls only adjust OpenCV.
+    void configure(const ThreadingConfig& config);
+    
+    // Resolved configuration. Without configure the defaults size the shared pool on first
+    // use, but OpenCV's thread count and the calling thread's pinning are left as they are
+    // (opencvThreads then reports cv::getNumThreads()).
+    ThreadingConfig currentConfig();
+    
+    // Per-worker pinning for a pool of threadCount workers under the current configuration
+    std::vector<std::vector<int>> workerAffinity(int threadCount);
+    
+    // Pool shared by the output writer and other pipeline stages, sized by poolThreads
+    TaskPool& sharedPool();
+}
\ No newline at end of file
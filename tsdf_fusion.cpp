@@ -0,0 +1,373 @@
+#include "tsdf_fusion.h"
+#include "stereo_calibration.h"
+#include "icp_registration.h"
+#include "point_cloud_normals.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <unordered_set>
+
+namespace TsdfFusion {
+
+namespace {
+
+const int VOXELS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+int floorDiv(int value, int divisor) {
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+int voxelIndex(int x, int y, int z) {
+    return (z * BLOCK_SIZE + y) * BLOCK_SIZE + x;
+}
+
+bool isFinitePoint(const cv::Vec3f& p) {
+    return std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+}
+
+cv::Vec3d transformPoint(const cv::Matx44d& T, const cv::Vec3d& p) {
+    return cv::Vec3d(T(0, 0) * p[0] + T(0, 1) * p[1] + T(0, 2) * p[2] + T(0, 3),
+                     T(1, 0) * p[0] + T(1, 1) * p[1] + T(1, 2) * p[2] + T(1, 3),
+                     T(2, 0) * p[0] + T(2, 1) * p[1] + T(2, 2) * p[2] + T(2, 3));
+}
+
+} // namespace
+
+CameraIntrinsics intrinsicsFromQ(const cv::Mat& Q) {
+    cv::Mat q;
+    Q.convertTo(q, CV_64F);
+    
+    CameraIntrinsics intrinsics;
+    intrinsics.cx = -q.at<double>(0, 3);
+    intrinsics.cy = -q.at<double>(1, 3);
+    intrinsics.fx = q.at<double>(2, 3);
+    intrinsics.fy = q.at<double>(2, 3);
+    return intrinsics;
+}
+
+TsdfVolume::TsdfVolume(const FusionParams& params) : params(params) {}
+
+int64_t TsdfVolume::blockKey(const cv::Vec3i& coord) {
+    // 21 bits per axis covers +-1M blocks
+    const int64_t mask = (int64_t(1) << 21) - 1;
+    return ((int64_t(coord[0]) & mask) << 42) | ((int64_t(coord[1]) & mask) << 21) | (int64_t(coord[2]) & mask);
+}
+
+const Voxel* TsdfVolume::voxelAt(const cv::Vec3i& global) const {
+    cv::Vec3i block(floorDiv(global[0], BLOCK_SIZE), floorDiv(global[1], BLOCK_SIZE),
+                    floorDiv(global[2], BLOCK_SIZE));
+    auto it = blockIndex.find(blockKey(block));
+    if (it == blockIndex.end()) {
+        return nullptr;
+    }
+    const VoxelBlock& b = blocks[it->second];
+    return &b.voxels[voxelIndex(global[0] - block[0] * BLOCK_SIZE, global[1] - block[1] * BLOCK_SIZE,
+                                global[2] - block[2] * BLOCK_SIZE)];
+}
+
+void TsdfVolume::reset() {
+    blockIndex.clear();
+    blocks.clear();
+}
+
+void TsdfVolume::integrate(const cv::Mat& points3D, const cv::Mat& colors,
+                           const cv::Matx44d& cameraToWorld, const CameraIntrinsics& intrinsics) {
+    CV_Assert(points3D.type() == CV_32FC3);
+    bool hasColor = !colors.empty() && colors.type() == CV_8UC3 && colors.size() == points3D.size();
+    
+    const double blockExtent = BLOCK_SIZE * params.voxelSize;
+    const double truncation = params.truncation;
+    
+    auto isMeasured = [&](const cv::Vec3f& p) {
+        return isFinitePoint(p) && p[2] > 0.0f && (params.maxDepth <= 0.0f || p[2] <= params.maxDepth);
+    };
+    
+    // 1. Blocks crossed by each measurement's truncation band along its viewing ray
+    std::mutex keysMutex;
+    std::unordered_set<int64_t> touchedKeys;
+    std::vector<cv::Vec3i> touchedCoords;
+    
+    cv::parallel_for_(cv::Range(0, points3D.rows), [&](const cv::Range& range) {
+        std::unordered_set<int64_t> localKeys;
+        std::vector<cv::Vec3i> localCoords;
+        
+        for (int y = range.start; y < range.end; y++) {
+            const cv::Vec3f* p = points3D.ptr<cv::Vec3f>(y);
+            for (int x = 0; x < points3D.cols; x++) {
+                if (!isMeasured(p[x])) {
+                    continue;
+                }
+                cv::Vec3d point(p[x][0], p[x][1], p[x][2]);
+                cv::Vec3d ray = point / cv::norm(point);
+                
+                for (double t = -truncation; t <= truncation + 1e-9; t += blockExtent * 0.5) {
+                    cv::Vec3d world = transformPoint(cameraToWorld, point + ray * std::min(t, truncation));
+                    cv::Vec3i coord(static_cast<int>(std::floor(world[0] / blockExtent)),
+                                    static_cast<int>(std::floor(world[1] / blockExtent)),
+                                    static_cast<int>(std::floor(world[2] / blockExtent)));
+                    if (localKeys.insert(blockKey(coord)).second) {
+                        localCoords.push_back(coord);
+                    }
+                }
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(keysMutex);
+        for (const auto& coord : localCoords) {
+            if (touchedKeys.insert(blockKey(coord)).second) {
+                touchedCoords.push_back(coord);
+            }
+        }
+    });
+    
+    // 2. Allocate new blocks (serial: the hash and block storage are not shared-writable)
+    std::vector<int> touchedBlocks;
+    touchedBlocks.reserve(touchedCoords.size());
+    for (const auto& coord : touchedCoords) {
+        auto inserted = blockIndex.emplace(blockKey(coord), static_cast<int>(blocks.size()));
+        if (inserted.second) {
+            blocks.emplace_back();
+            VoxelBlock& block = blocks.back();
+            block.coord = coord;
+            for (auto& voxel : block.voxels) {
+                voxel.tsdf = 1.0f;
+                voxel.weight = 0.0f;
+                voxel.color = cv::Vec3b(0, 0, 0);
+            }
+        }
+        touchedBlocks.push_back(inserted.first->second);
+    }
+    
+    // 3. Project every voxel of the touched blocks into the frame and update its running average
+    cv::Matx44d worldToCamera = cameraToWorld.inv();
+    const int cols = points3D.cols;
+    const int rows = points3D.rows;
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(touchedBlocks.size())), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            VoxelBlock& block = blocks[touchedBlocks[i]];
+            cv::Vec3i origin = block.coord * BLOCK_SIZE;
+            
+            for (int z = 0; z < BLOCK_SIZE; z++) {
+                for (int y = 0; y < BLOCK_SIZE; y++) {
+                    for (int x = 0; x < BLOCK_SIZE; x++) {
+                        cv::Vec3d world((origin[0] + x + 0.5) * params.voxelSize,
+                                        (origin[1] + y + 0.5) * params.voxelSize,
+                                        (origin[2] + z + 0.5) * params.voxelSize);
+                        cv::Vec3d camera = transformPoint(worldToCamera, world);
+                        if (camera[2] <= 0.0) {
+                            continue;
+                        }
+                        
+                        int u = static_cast<int>(std::lround(intrinsics.fx * camera[0] / camera[2] + intrinsics.cx));
+                        int v = static_cast<int>(std::lround(intrinsics.fy * camera[1] / camera[2] + intrinsics.cy));
+                        if (u < 0 || v < 0 || u >= cols || v >= rows) {
+                            continue;
+                        }
+                        
+                        const cv::Vec3f& measured = points3D.at<cv::Vec3f>(v, u);
+                        if (!isMeasured(measured)) {
+                            continue;
+                        }
+                        
+                        // Projective signed distance along the optical axis
+                        double sdf = measured[2] - camera[2];
+                        if (sdf < -truncation) {
+                            continue;
+                        }
+                        float tsdf = static_cast<float>(std::min(1.0, sdf / truncation));
+                        
+                        Voxel& voxel = block.voxels[voxelIndex(x, y, z)];
+                        float weight = voxel.weight + 1.0f;
+                        voxel.tsdf = (voxel.tsdf * voxel.weight + tsdf) / weight;
+                        if (hasColor) {
+                            const cv::Vec3b& c = colors.at<cv::Vec3b>(v, u);
+                            for (int k = 0; k < 3; k++) {
+                                voxel.color[k] = cv::saturate_cast<uchar>((voxel.color[k] * voxel.weight + c[k]) / weight);
+                            }
+                        }
+                        voxel.weight = std::min(weight, params.maxWeight);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void TsdfVolume::extractPointCloud(std::vector<cv::Vec3f>& points, std::vector<cv::Vec3b>& colors,
+                                   std::vector<cv::Vec3f>& normals) const {
+    points.clear();
+    colors.clear();
+    normals.clear();
+    
+    std::mutex outputMutex;
+    const cv::Vec3i axes[3] = {cv::Vec3i(1, 0, 0), cv::Vec3i(0, 1, 0), cv::Vec3i(0, 0, 1)};
+    
+    // Central-difference TSDF gradient; points along free space, i.e. out of the surface
+    auto gradientAt = [&](const cv::Vec3i& g, cv::Vec3f& normal) {
+        cv::Vec3f gradient;
+        for (int k = 0; k < 3; k++) {
+            const Voxel* next = voxelAt(g + axes[k]);
+            const Voxel* prev = voxelAt(g - axes[k]);
+            if (!next || !prev || next->weight <= 0.0f || prev->weight <= 0.0f) {
+                return false;
+            }
+            gradient[k] = next->tsdf - prev->tsdf;
+        }
+        float length = static_cast<float>(cv::norm(gradient));
+        if (length <= 0.0f) {
+            return false;
+        }
+        normal = gradient / length;
+        return true;
+    };
+    
+    cv::parallel_for_(cv::Range(0, static_cast<int>(blocks.size())), [&](const cv::Range& range) {
+        std::vector<cv::Vec3f> localPoints, localNormals;
+        std::vector<cv::Vec3b> localColors;
+        
+        for (int i = range.start; i < range.end; i++) {
+            const VoxelBlock& block = blocks[i];
+            cv::Vec3i origin = block.coord * BLOCK_SIZE;
+            
+            for (int z = 0; z < BLOCK_SIZE; z++) {
+                for (int y = 0; y < BLOCK_SIZE; y++) {
+                    for (int x = 0; x < BLOCK_SIZE; x++) {
+                        const Voxel& voxel = block.voxels[voxelIndex(x, y, z)];
+                        if (voxel.weight <= 0.0f) {
+                            continue;
+                        }
+                        cv::Vec3i g = origin + cv::Vec3i(x, y, z);
+                        
+                        for (int k = 0; k < 3; k++) {
+                            const Voxel* neighbor = voxelAt(g + axes[k]);
+                            if (!neighbor || neighbor->weight <= 0.0f ||
+                                (voxel.tsdf > 0.0f) == (neighbor->tsdf > 0.0f)) {
+                                continue;
+                            }
+                            
+                            // Linear interpolation of the zero crossing between the two voxel centers
+                            float t = voxel.tsdf / (voxel.tsdf - neighbor->tsdf);
+                            cv::Vec3f position((g[0] + 0.5f + t * axes[k][0]) * params.voxelSize,
+                                               (g[1] + 0.5f + t * axes[k][1]) * params.voxelSize,
+                                               (g[2] + 0.5f + t * axes[k][2]) * params.voxelSize);
+                            
+                            cv::Vec3f normal(0.0f, 0.0f, 0.0f);
+                            if (!gradientAt(t < 0.5f ? g : g + axes[k], normal)) {
+                                normal = cv::Vec3f(std::numeric_limits<float>::quiet_NaN(), 0.0f, 0.0f);
+                            }
+                            
+                            localPoints.push_back(position);
+                            localColors.push_back(t < 0.5f ? voxel.color : neighbor->color);
+                            localNormals.push_back(normal);
+                        }
+                    }
+                }
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(outputMutex);
+        points.insert(points.end(), localPoints.begin(), localPoints.end());
+        colors.insert(colors.end(), localColors.begin(), localColors.end());
+        normals.insert(normals.end(), localNormals.begin(), localNormals.end());
+    });
+}
+
+bool TsdfVolume::savePointCloud(const std::string& filename) const {
+    std::vector<cv::Vec3f> points, normals;
+    std::vector<cv::Vec3b> colors;
+    extractPointCloud(points, colors, normals);
+    if (points.empty()) {
+        std::cerr << "TSDF volume has no surface to extract" << std::endl;
+        return false;
+    }
+    
+    // One-row organized views, so the regular PLY writer handles colors and normals
+    int count = static_cast<int>(points.size());
+    cv::Mat pointRow(1, count, CV_32FC3, points.data());
+    cv::Mat colorRow(1, count, CV_8UC3, colors.data());
+    cv::Mat normalRow(1, count, CV_32FC3, normals.data());
+    return StereoReconstruction::savePointCloud(pointRow, colorRow, filename, 0,
+                                               cv::Mat(), 0.0f, normalRow);
+}
+
+bool fuseReconstructions(const std::vector<StereoReconstruction::ReconstructionParams>& pairs,
+                         const std::vector<cv::Matx44d>& cameraToWorld,
+                         const FusionParams& params, const std::string& outputFile) {
+    if (pairs.empty() || (!cameraToWorld.empty() && cameraToWorld.size() != pairs.size())) {
+        std::cerr << "Fusion needs one pose per image pair" << std::endl;
+        return false;
+    }
+    
+    TsdfVolume volume(params);
+    int integrated = 0;
+    
+    // Without known poses each pair is registered to the previously integrated one
+    IcpRegistration::PointCloud previousCloud;
+    cv::Matx44d previousPose = cv::Matx44d::eye();
+    
+    for (size_t i = 0; i < pairs.size(); i++) {
+        StereoReconstruction::ReconstructionOutput output =
+            StereoReconstruction::performStereoReconstruction(pairs[i]);
+        if (!output.success) {
+            std::cerr << "Skipping pair " << i << ": reconstruction failed" << std::endl;
+            continue;
+        }
+        
+        StereoCalibration::StereoCalibrationResult calibration;
+        if (!StereoCalibration::loadCalibrationXML(pairs[i].calibrationFile, calibration)) {
+            std::cerr << "Skipping pair " << i << ": cannot load calibration data" << std::endl;
+            continue;
+        }
+        calibration = StereoCalibration::scaleCalibration(calibration, pairs[i].decodeScale);
+        
+        // Invalid disparities reproject to finite points; keep only matched pixels
+        cv::Mat points = output.pointCloud3D;
+        points.setTo(cv::Scalar::all(std::numeric_limits<float>::quiet_NaN()), output.depthMap <= 0);
+        
+        cv::Matx44d pose = cameraToWorld.empty() ? cv::Matx44d::eye() : cameraToWorld[i];
+        if (cameraToWorld.empty()) {
+            cv::Mat normals;
+            PointCloudNormals::computeNormals(points, normals);
+            IcpRegistration::PointCloud cloud = IcpRegistration::compactCloud(points, normals);
+            
+            if (!previousCloud.points.empty()) {
+                IcpRegistration::IcpParams icpParams;
+                icpParams.maxCorrespondenceDistance = params.truncation;
+                IcpRegistration::IcpResult registration =
+                    IcpRegistration::alignPointToPlane(cloud, previousCloud, cv::Matx44d::eye(), icpParams);
+                pose = previousPose * registration.transform;
+                std::cout << "Registered pair " << i << " to pair " << i - 1 << ", rms "
+                          << registration.finalRms << (registration.converged ? "" : " (not converged)") << std::endl;
+            }
+            previousCloud = std::move(cloud);
+            previousPose = pose;
+        }
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        cv::Mat colors = output.rectifiedLeft.type() == CV_8UC3 ? output.rectifiedLeft : output.pointColors;
+        // The cloud covers output.roi of the rectified frame
+        CameraIntrinsics intrinsics = intrinsicsFromQ(calibration.Q);
+        intrinsics.cx -= output.roi.x;
+        intrinsics.cy -= output.roi.y;
+        volume.integrate(points, colors, pose, intrinsics);
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        std::cout << "Integrated pair " << i << " in "
+                  << std::chrono::duration<double, std::milli>(end - start).count() << " ms, "
+                  << volume.blockCount() << " blocks ("
+                  << volume.memoryBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        integrated++;
+    }
+    
+    if (integrated == 0) {
+        return false;
+    }
+    return volume.savePointCloud(outputFile);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include "stereo_reconstruction.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace TsdfFusion {
+    // Pinhole model of the rectified left camera
+    struct CameraIntrinsics {
+        double fx, fy, cx, cy;
+    };
+    
+    // Q = [1 0 0 -cx; 0 1 0 -cy; 0 0 0 f; 0 0 -1/Tx (cx - cx')/Tx]
+    CameraIntrinsics intrinsicsFromQ(const cv::Mat& Q);
+    
+    struct FusionParams {
+        float voxelSize = 2.0f;    // calibration units (the square size unit, e.g. mm)
+        float truncation = 8.0f;   // TSDF truncation distance, a few voxels
+        float maxWeight = 64.0f;   // caps the running average so the model can still adapt
+        float maxDepth = 0.0f;     // ignore measurements beyond this depth, 0 = no limit
+    };
+    
+    struct Voxel {
+        float tsdf;
+        float weight;
+        cv::Vec3b color;
+    };
+    
+    const int BLOCK_SIZE = 8; // voxels per block edge
+    
+    struct VoxelBlock {
+        cv::Vec3i coord;
+        Voxel voxels[BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE];
+    };
+    
+    // Truncated signed distance volume stored as 8^3 voxel blocks in a spatial hash, so only
+    // blocks near observed surfaces are allocated
+    class TsdfVolume {
+    public:
+        explicit TsdfVolume(const FusionParams& params = FusionParams());
+        
+        // Integrates an organized CV_32FC3 cloud (reprojectImageTo3D output, left camera frame)
+        // observed from cameraToWorld. colors (CV_8UC3) are optional. Block allocation and
+        // voxel updates run in parallel; each block is updated by a single worker.
+        void integrate(const cv::Mat& points3D, const cv::Mat& colors,
+                       const cv::Matx44d& cameraToWorld, const CameraIntrinsics& intrinsics);
+        
+        // Surface points at TSDF zero crossings, with normals from the TSDF gradient
+        void extractPointCloud(std::vector<cv::Vec3f>& points, std::vector<cv::Vec3b>& colors,
+                               std::vector<cv::Vec3f>& normals) const;
+        
+        bool savePointCloud(const std::string& filename) const;
+        
+        size_t blockCount() const { return blocks.size(); }
+        size_t memoryBytes() const { return blocks.capacity() * sizeof(VoxelBlock); }
+        void reset();
+        
+    private:
+        static int64_t blockKey(const cv::Vec3i& coord);
+        const Voxel* voxelAt(const cv::Vec3i& global) const;
+        
+        FusionParams params;
+        std::unordered_map<int64_t, int> blockIndex;
+        std::vector<VoxelBlock> blocks;
+    };
+    
+    // Reconstructs every pair and fuses the clouds into one model. Poses map each pair's left
+    // camera into the world frame; when empty each pair is registered to the previous one
+    // with point-to-plane ICP, starting from the first pair's frame.
+    bool fuseReconstructions(const std::vector<StereoReconstruction::ReconstructionParams>& pairs,
+                             const std::vector<cv::Matx44d>& cameraToWorld,
+                             const FusionParams& params, const std::string& outputFile);
+}
\ No newline at end of file